@@ -21,6 +21,14 @@ namespace SoftRenderer
             glm::vec3 lightDirection;
         };
 
+        // optional per instance data, replaces the matching uniforms in instanced draws
+        struct ShaderInstanceData
+        {
+            glm::mat4 modelMatrix;
+            glm::mat4 modelViewProjectMatrix;
+            glm::mat3 inverseTransposeModelMatrix;
+        };
+
         struct ShaderUniforms
         {
             glm::mat4 modelMatrix;
@@ -58,13 +66,15 @@ namespace SoftRenderer
 
             void shaderMain() override
             {
-                glm::mat4 modelMatrix = u->modelMatrix;
-                glm::mat4 modelViewProjMatrix = u->modelViewProjectMatrix;
+                const auto* instance = static_cast<const ShaderInstanceData*>(gl_InstanceData);
+                const glm::mat4& modelMatrix = instance ? instance->modelMatrix : u->modelMatrix;
+                const glm::mat4& modelViewProjMatrix = instance ? instance->modelViewProjectMatrix : u->modelViewProjectMatrix;
+                const glm::mat3& inverseTransposeModelMatrix = instance ? instance->inverseTransposeModelMatrix : u->inverseTransposeModelMatrix;
 
                 glm::vec4 localPosition = glm::vec4(a->position, 1.0f);
                 glm::vec3 worldPosition = glm::vec3(modelMatrix * localPosition);
 
-                gl_Position = u->modelViewProjectMatrix * localPosition;
+                gl_Position = modelViewProjMatrix * localPosition;
 
                 v->textureCoord = a->textureCoord;
 
@@ -76,8 +86,8 @@ namespace SoftRenderer
                 if (!u->normalMap.isEmpty())
                 {
                     // TBN
-                    glm::vec3 N = glm::normalize(u->inverseTransposeModelMatrix * a->normal);
-                    glm::vec3 T = glm::normalize(u->inverseTransposeModelMatrix * a->tangent);
+                    glm::vec3 N = glm::normalize(inverseTransposeModelMatrix * a->normal);
+                    glm::vec3 T = glm::normalize(inverseTransposeModelMatrix * a->tangent);
                     // Gram-Schmidt process re-orthogonalize T with respect to N
                     T = glm::normalize(T - glm::dot(T, N) * N);
                     glm::vec3 B = glm::cross(T, N);
@@ -108,6 +118,18 @@ namespace SoftRenderer
                 return glm::normalize(normal * 2.0f - 1.0f);
             }
 
+            glm::vec4 quadDiffuseColor[4];
+
+            void shaderQuadMain(void* const varyings[4]) override
+            {
+                glm::vec2 uv[4];
+                for (int32_t i = 0; i < 4; i++)
+                {
+                    uv[i] = static_cast<ShaderVaryings*>(varyings[i])->textureCoord;
+                }
+                u->diffuseMap.texture2DQuad(uv, quadDiffuseColor);
+            }
+
             const float pointLightRangeInverse = 1.0f / 5.0f;
             const float specularShininess = 128.0f;
             const float specularStrength = 1.0f;
@@ -172,7 +194,7 @@ namespace SoftRenderer
 
             void shaderMain() override
             {
-                gl_FragColor = u->diffuseMap.texture2D(v->textureCoord);
+                gl_FragColor = quadDiffuseColor[gl_QuadPixelIndex];
 
                 return;
 
@@ -238,6 +260,10 @@ namespace SoftRenderer
                 gl_FragColor = glm::vec4(diffuseColor + outSpecularColor + emissiveColor, 1.0f);
             }
 
+            FragDepthLayout getFragDepthLayout() const override { return FragDepthLayout::DEPTH_UNCHANGED; }
+
+            bool usesDiscard() const override { return false; }
+
             CLONE_FRAGMENT_SHADER(BlinnPhongFragmentShader)
         };
     }
@@ -1,9 +1,14 @@
 #pragma once
 
 #include <memory>
+#include <cstdint>
+#include <cstring>
 
 namespace SoftRenderer
 {
+    template<typename T>
+    class LinearTextureBuffer;
+
     template<typename T>
     class TextureBuffer
     {
@@ -33,7 +38,7 @@ namespace SoftRenderer
 
             init(other.mWidth, other.mHeight);
 
-            std::memcpy(mData->get(), other.mData->get(), mDataSize * sizeof(T));
+            std::memcpy(mData.get(), other.mData.get(), mDataSize * sizeof(T));
         }
 
         TextureBuffer& operator=(const TextureBuffer& other)
@@ -42,7 +47,9 @@ namespace SoftRenderer
 
             init(other.mWidth, other.mHeight);
 
-            std::memcpy(mData->get(), other.mData->get(), mDataSize * sizeof(T));
+            std::memcpy(mData.get(), other.mData.get(), mDataSize * sizeof(T));
+
+            return *this;
         }
 
         void init(uint32_t width, uint32_t height)
@@ -94,6 +101,12 @@ namespace SoftRenderer
             return mData.get();
         }
 
+        // true when texel (x, y) is getData()[y * getWidth() + x]
+        virtual bool isLinearLayout() const
+        {
+            return false;
+        }
+
         inline T* get(uint32_t x, uint32_t y)
         {
             T* dataPtr = mData.get();
@@ -183,21 +196,26 @@ namespace SoftRenderer
     {
     public:
         LinearTextureBuffer(int32_t width, int32_t height)
-        : TextureBuffer(width, height)
+        : TextureBuffer<T>(width, height)
+        {
+            this->init(width, height);
+        }
+
+        bool isLinearLayout() const override
         {
-            init(width, height);
+            return true;
         }
 
     private:
         inline void initLayout() override
         {
-            mInnerWidth  = mWidth;
-            mInnerHeight = mHeight;
+            this->mInnerWidth  = this->mWidth;
+            this->mInnerHeight = this->mHeight;
         }
 
         inline uint32_t convertIndex(uint32_t x, uint32_t y) const override
         {
-            return y * mInnerWidth + x;
+            return y * this->mInnerWidth + x;
         }
     };
 
@@ -206,17 +224,17 @@ namespace SoftRenderer
     {
     public:
         TiledTextureBuffer(int32_t width, int32_t height)
-        : TextureBuffer(width, height)
+        : TextureBuffer<T>(width, height)
         {}
 
     private:
 
         inline void initLayout() override
         {
-            mTileWidth   = (mWidth + tileSize - 1) / tileSize;
-            mTileHeight  = (mHeight + tileSize - 1) / tileSize;
-            mInnerWidth  =  mTileWidth * tileSize;
-            mInnerHeight =  mTileHeight * tileSize;
+            mTileWidth   = (this->mWidth + tileSize - 1) / tileSize;
+            mTileHeight  = (this->mHeight + tileSize - 1) / tileSize;
+            this->mInnerWidth  =  mTileWidth * tileSize;
+            this->mInnerHeight =  mTileHeight * tileSize;
         }
 
         inline uint32_t convertIndex(uint32_t x, uint32_t y) const override
@@ -225,12 +243,12 @@ namespace SoftRenderer
             //Note: this is naive version
             //return ((y / tileSize) * mTileWidth + (x / tileSize)) * tileSize * tileSize  + (y % tileSize) * tileSize + x % tileSize;
             //Note: this is optimized version
-            uint16_t tileX = x >> bits_;              // x / tileSize
-            uint16_t tileY = y >> bits_;              // y / tileSize
+            uint16_t tileX = x >> bits;              // x / tileSize
+            uint16_t tileY = y >> bits;              // y / tileSize
             uint16_t inTileX = x & (tileSize - 1);    // x % tileSize
             uint16_t inTileY = y & (tileSize - 1);    // y % tileSize
 
-            return ((tileY * mTileWidth + tileX) << bits_ << bits_) + (inTileY << bits_) + inTileX;
+            return ((tileY * mTileWidth + tileX) << bits << bits) + (inTileY << bits) + inTileX;
         }
 
     private:
@@ -245,7 +263,7 @@ namespace SoftRenderer
     {
     public:
         MortonTextureBuffer(int32_t width, int32_t height)
-        :TextureBuffer(width, height)
+        :TextureBuffer<T>(width, height)
         {}
 
     private:
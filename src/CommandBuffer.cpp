@@ -0,0 +1,113 @@
+#include "CommandBuffer.h"
+
+namespace SoftRenderer
+{
+    void CommandBuffer::useProgram(std::shared_ptr<Program> program)
+    {
+        Command command;
+        command.type = CommandType::USE_PROGRAM;
+        command.value = (uint32_t)mPrograms.size();
+        mPrograms.push_back(std::move(program));
+        mCommands.push_back(command);
+    }
+
+    void CommandBuffer::setUniforms(const void* data, size_t size)
+    {
+        Command command;
+        command.type = CommandType::SET_UNIFORMS;
+        command.dataOffset = pushData(data, size);
+        command.dataSize = (uint32_t)size;
+        mCommands.push_back(command);
+    }
+
+    void CommandBuffer::setDepthTest(bool enable)
+    {
+        Command command;
+        command.type = CommandType::SET_DEPTH_TEST;
+        command.value = enable;
+        mCommands.push_back(command);
+    }
+
+    void CommandBuffer::setDepthWrite(bool enable)
+    {
+        Command command;
+        command.type = CommandType::SET_DEPTH_WRITE;
+        command.value = enable;
+        mCommands.push_back(command);
+    }
+
+    void CommandBuffer::setDepthFunc(Graphics::DepthFunc func)
+    {
+        Command command;
+        command.type = CommandType::SET_DEPTH_FUNC;
+        command.value = (uint32_t)func;
+        mCommands.push_back(command);
+    }
+
+    void CommandBuffer::setDepthPrepass(Graphics::DepthPrepass prepass)
+    {
+        Command command;
+        command.type = CommandType::SET_DEPTH_PREPASS;
+        command.value = (uint32_t)prepass;
+        mCommands.push_back(command);
+    }
+
+    void CommandBuffer::drawMesh(const Mesh* mesh)
+    {
+        Command command;
+        command.type = CommandType::DRAW_MESH;
+        command.mesh = mesh;
+        mCommands.push_back(command);
+    }
+
+    void CommandBuffer::drawMesh(const Mesh* mesh, const glm::mat4& modelViewProject)
+    {
+        Command command;
+        command.type = CommandType::DRAW_MESH_CULLED;
+        command.mesh = mesh;
+        command.dataOffset = pushData(&modelViewProject, sizeof(glm::mat4));
+        command.dataSize = sizeof(glm::mat4);
+        mCommands.push_back(command);
+    }
+
+    void CommandBuffer::drawSubMesh(const SubMesh* subMesh, uint32_t firstIndex, uint32_t indexCount)
+    {
+        Command command;
+        command.type = CommandType::DRAW_SUB_MESH;
+        command.subMesh = subMesh;
+        command.first = firstIndex;
+        command.count = indexCount;
+        mCommands.push_back(command);
+    }
+
+    void CommandBuffer::drawMeshInstanced(const Mesh* mesh, uint32_t instanceCount, const void* instanceData, size_t instanceDataStride)
+    {
+        Command command;
+        command.type = CommandType::DRAW_MESH_INSTANCED;
+        command.mesh = mesh;
+        command.count = instanceCount;
+        command.stride = (uint32_t)instanceDataStride;
+        if (instanceData)
+        {
+            command.dataSize = (uint32_t)(instanceCount * instanceDataStride);
+            command.dataOffset = pushData(instanceData, command.dataSize);
+        }
+        mCommands.push_back(command);
+    }
+
+    void CommandBuffer::reset()
+    {
+        mCommands.clear();
+        mPrograms.clear();
+        mData.clear();
+    }
+
+    uint32_t CommandBuffer::pushData(const void* data, size_t size)
+    {
+        // 16 byte aligned offsets, shaders read instance data in place
+        const size_t offset = (mData.size() + 15) & ~size_t(15);
+        mData.resize(offset + size);
+        std::memcpy(mData.data() + offset, data, size);
+        return (uint32_t)offset;
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include "Graphics.h"
+
+namespace SoftRenderer
+{
+    /**
+     * Records programs, uniforms, depth state and draws for Graphics::submit.
+     * Uniforms and instance data are copied when recorded, so the caller may reuse its memory right away.
+     * A command buffer is recorded by one thread at a time, different command buffers may be recorded concurrently.
+     */
+    class CommandBuffer
+    {
+    public:
+        enum class CommandType
+        {
+            USE_PROGRAM,
+            SET_UNIFORMS,
+            SET_DEPTH_TEST,
+            SET_DEPTH_WRITE,
+            SET_DEPTH_FUNC,
+            SET_DEPTH_PREPASS,
+            DRAW_MESH,
+            DRAW_MESH_CULLED,
+            DRAW_SUB_MESH,
+            DRAW_MESH_INSTANCED,
+        };
+
+        struct Command
+        {
+            CommandType type;
+
+            // USE_PROGRAM: index into the programs, SET_*: the new state value
+            uint32_t value = 0;
+
+            // SET_UNIFORMS, DRAW_MESH_CULLED, DRAW_MESH_INSTANCED: bytes in the data storage
+            uint32_t dataOffset = 0;
+            uint32_t dataSize = 0;
+
+            const Mesh* mesh = nullptr;
+            const SubMesh* subMesh = nullptr;
+
+            // DRAW_SUB_MESH: index range, DRAW_MESH_INSTANCED: count = instance count
+            uint32_t first = 0;
+            uint32_t count = 0;
+            uint32_t stride = 0;
+        };
+
+    public:
+        CommandBuffer() = default;
+        ~CommandBuffer() = default;
+
+        void useProgram(std::shared_ptr<Program> program);
+
+        void setUniforms(const void* data, size_t size);
+
+        void setDepthTest(bool enable);
+
+        void setDepthWrite(bool enable);
+
+        void setDepthFunc(Graphics::DepthFunc func);
+
+        void setDepthPrepass(Graphics::DepthPrepass prepass);
+
+        void drawMesh(const Mesh* mesh);
+
+        void drawMesh(const Mesh* mesh, const glm::mat4& modelViewProject);
+
+        void drawSubMesh(const SubMesh* subMesh, uint32_t firstIndex = 0, uint32_t indexCount = UINT32_MAX);
+
+        void drawMeshInstanced(const Mesh* mesh, uint32_t instanceCount, const void* instanceData, size_t instanceDataStride);
+
+        // submit may reorder the draws of this buffer by program, only for draws whose order does not matter
+        void setSortByProgram(bool enable) { mSortByProgram = enable; }
+
+        bool getSortByProgram() const { return mSortByProgram; }
+
+        // drops the recorded commands but keeps the storage for the next frame
+        void reset();
+
+        const std::vector<Command>& getCommands() const { return mCommands; }
+
+        const std::shared_ptr<Program>& getProgram(uint32_t index) const { return mPrograms[index]; }
+
+        const uint8_t* getData(uint32_t offset) const { return mData.data() + offset; }
+
+    private:
+        uint32_t pushData(const void* data, size_t size);
+
+    private:
+        std::vector<Command> mCommands;
+        std::vector<std::shared_ptr<Program>> mPrograms;
+        std::vector<uint8_t> mData;
+
+        bool mSortByProgram = false;
+    };
+}
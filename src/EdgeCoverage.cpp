@@ -0,0 +1,94 @@
+#include "EdgeCoverage.h"
+
+namespace SoftRenderer
+{
+    static const int32_t LANE_DX[EdgeCoverage::LANE_COUNT] = { 0, 1, 0, 1, 2, 3, 2, 3 };
+    static const int32_t LANE_DY[EdgeCoverage::LANE_COUNT] = { 0, 0, 1, 1, 0, 0, 1, 1 };
+
+    const EdgeCoverage::CoverageFunc EdgeCoverage::sCoverageFunc = EdgeCoverage::selectCoverageFunc();
+
+    EdgeCoverage::CoverageFunc EdgeCoverage::selectCoverageFunc()
+    {
+#if SOFTGL_SIMD_X86
+        switch (SIMD::getLevel())
+        {
+        case SIMDLevel::SIMD_AVX2: return &EdgeCoverage::coverageAVX2;
+        case SIMDLevel::SIMD_SSE41: return &EdgeCoverage::coverageSSE41;
+        default: break;
+        }
+#endif
+        return &EdgeCoverage::coverageScalar;
+    }
+
+    void EdgeCoverage::setup(Setup& setup, const int32_t I[3], const int32_t J[3])
+    {
+        for (int32_t lane = 0; lane < LANE_COUNT; lane++)
+        {
+            for (int32_t e = 0; e < 3; e++)
+            {
+                setup.edgeOffsets[e][lane] = LANE_DX[lane] * I[e] + LANE_DY[lane] * J[e];
+            }
+            setup.laneX[lane] = LANE_DX[lane];
+            setup.laneY[lane] = LANE_DY[lane];
+        }
+    }
+
+    uint32_t EdgeCoverage::coverageScalar(const Setup& setup, const int32_t edge[3], int32_t boundX, int32_t boundY)
+    {
+        uint32_t mask = 0;
+        for (int32_t lane = 0; lane < LANE_COUNT; lane++)
+        {
+            //Invalid fragment
+            if (setup.laneX[lane] > boundX || setup.laneY[lane] > boundY)
+            {
+                continue;
+            }
+
+            //Note: Counter-clockwise winding order
+            if (edge[0] + setup.edgeOffsets[0][lane] >= 0 &&
+                edge[1] + setup.edgeOffsets[1][lane] >= 0 &&
+                edge[2] + setup.edgeOffsets[2][lane] >= 0)
+            {
+                mask |= 1u << lane;
+            }
+        }
+        return mask;
+    }
+
+#if SOFTGL_SIMD_X86
+    // a lane is covered when min(E0, E1, E2, boundX - laneX, boundY - laneY) >= 0, i.e. its sign bit is clear
+
+    SOFTGL_TARGET_SSE41
+    uint32_t EdgeCoverage::coverageSSE41(const Setup& setup, const int32_t edge[3], int32_t boundX, int32_t boundY)
+    {
+        uint32_t mask = 0;
+        for (int32_t half = 0; half < 2; half++)
+        {
+            const int32_t base = half * 4;
+
+            __m128i e0 = _mm_add_epi32(_mm_set1_epi32(edge[0]), _mm_load_si128((const __m128i*)(setup.edgeOffsets[0] + base)));
+            __m128i e1 = _mm_add_epi32(_mm_set1_epi32(edge[1]), _mm_load_si128((const __m128i*)(setup.edgeOffsets[1] + base)));
+            __m128i e2 = _mm_add_epi32(_mm_set1_epi32(edge[2]), _mm_load_si128((const __m128i*)(setup.edgeOffsets[2] + base)));
+            __m128i bx = _mm_sub_epi32(_mm_set1_epi32(boundX), _mm_load_si128((const __m128i*)(setup.laneX + base)));
+            __m128i by = _mm_sub_epi32(_mm_set1_epi32(boundY), _mm_load_si128((const __m128i*)(setup.laneY + base)));
+
+            __m128i m = _mm_min_epi32(_mm_min_epi32(e0, e1), _mm_min_epi32(e2, _mm_min_epi32(bx, by)));
+            mask |= (uint32_t)(~_mm_movemask_ps(_mm_castsi128_ps(m)) & 0xF) << base;
+        }
+        return mask;
+    }
+
+    SOFTGL_TARGET_AVX2
+    uint32_t EdgeCoverage::coverageAVX2(const Setup& setup, const int32_t edge[3], int32_t boundX, int32_t boundY)
+    {
+        __m256i e0 = _mm256_add_epi32(_mm256_set1_epi32(edge[0]), _mm256_load_si256((const __m256i*)setup.edgeOffsets[0]));
+        __m256i e1 = _mm256_add_epi32(_mm256_set1_epi32(edge[1]), _mm256_load_si256((const __m256i*)setup.edgeOffsets[1]));
+        __m256i e2 = _mm256_add_epi32(_mm256_set1_epi32(edge[2]), _mm256_load_si256((const __m256i*)setup.edgeOffsets[2]));
+        __m256i bx = _mm256_sub_epi32(_mm256_set1_epi32(boundX), _mm256_load_si256((const __m256i*)setup.laneX));
+        __m256i by = _mm256_sub_epi32(_mm256_set1_epi32(boundY), _mm256_load_si256((const __m256i*)setup.laneY));
+
+        __m256i m = _mm256_min_epi32(_mm256_min_epi32(e0, e1), _mm256_min_epi32(e2, _mm256_min_epi32(bx, by)));
+        return (uint32_t)(~_mm256_movemask_ps(_mm256_castsi256_ps(m)) & 0xFF);
+    }
+#endif
+}
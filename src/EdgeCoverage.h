@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+#include "SIMD.h"
+
+namespace SoftRenderer
+{
+    /**
+     * Coverage test of two horizontally adjacent 2x2 quads against the three edge functions of a triangle.
+     * Lanes 0-3 are the quad at (x, y), lanes 4-7 the quad at (x + 2, y), both in FragmentQuad pixel order:
+     *
+     *   2--3  6--7
+     *   |  |  |  |
+     *   0--1  4--5
+     */
+    class EdgeCoverage
+    {
+    public:
+        static constexpr int32_t LANE_COUNT = 8;
+
+        struct Setup
+        {
+            // per lane step of each edge function relative to the pixel (x, y)
+            alignas(32) int32_t edgeOffsets[3][LANE_COUNT];
+            // pixel offset of each lane, to clip against the triangle bounding box
+            alignas(32) int32_t laneX[LANE_COUNT];
+            alignas(32) int32_t laneY[LANE_COUNT];
+        };
+
+        // I = edge function step in x, J = step in y
+        static void setup(Setup& setup, const int32_t I[3], const int32_t J[3]);
+
+        // returns a bit per lane whose pixel is inside all three edges and satisfies laneX <= boundX, laneY <= boundY
+        static uint32_t coverage(const Setup& setup, const int32_t edge[3], int32_t boundX, int32_t boundY)
+        {
+            return sCoverageFunc(setup, edge, boundX, boundY);
+        }
+
+        static uint32_t coverageScalar(const Setup& setup, const int32_t edge[3], int32_t boundX, int32_t boundY);
+
+#if SOFTGL_SIMD_X86
+        static uint32_t coverageSSE41(const Setup& setup, const int32_t edge[3], int32_t boundX, int32_t boundY);
+
+        static uint32_t coverageAVX2(const Setup& setup, const int32_t edge[3], int32_t boundX, int32_t boundY);
+#endif
+
+    private:
+        using CoverageFunc = uint32_t(*)(const Setup&, const int32_t[3], int32_t, int32_t);
+
+        static CoverageFunc selectCoverageFunc();
+
+        static const CoverageFunc sCoverageFunc;
+    };
+}
@@ -1,20 +1,109 @@
 #include "FrameBuffer.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <iostream>
 
+#include "Image.h"
+#include "SIMD.h"
+
 namespace SoftRenderer
 {
-	FrameBuffer::FrameBuffer(uint32_t width, uint32_t height)
-		:mWidth(width), mHeight(height)
+	// fills count 32 bit words at dst with value, dst needs no alignment
+	using Fill32Func = void(*)(void* dst, uint32_t value, size_t count);
+
+	static void fill32Scalar(void* dst, uint32_t value, size_t count)
+	{
+		uint8_t* bytes = static_cast<uint8_t*>(dst);
+		for (size_t i = 0; i < count; i++)
+		{
+			std::memcpy(bytes + i * 4, &value, 4);
+		}
+	}
+
+#if SOFTGL_SIMD_X86
+	SOFTGL_TARGET_SSE41
+	static void fill32SSE41(void* dst, uint32_t value, size_t count)
+	{
+		__m128i* out = static_cast<__m128i*>(dst);
+		const __m128i v = _mm_set1_epi32((int32_t)value);
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16, out += 4)
+		{
+			_mm_storeu_si128(out + 0, v);
+			_mm_storeu_si128(out + 1, v);
+			_mm_storeu_si128(out + 2, v);
+			_mm_storeu_si128(out + 3, v);
+		}
+		for (; i + 4 <= count; i += 4, out++)
+		{
+			_mm_storeu_si128(out, v);
+		}
+		fill32Scalar(out, value, count - i);
+	}
+
+	SOFTGL_TARGET_AVX2
+	static void fill32AVX2(void* dst, uint32_t value, size_t count)
+	{
+		__m256i* out = static_cast<__m256i*>(dst);
+		const __m256i v = _mm256_set1_epi32((int32_t)value);
+
+		size_t i = 0;
+		for (; i + 32 <= count; i += 32, out += 4)
+		{
+			_mm256_storeu_si256(out + 0, v);
+			_mm256_storeu_si256(out + 1, v);
+			_mm256_storeu_si256(out + 2, v);
+			_mm256_storeu_si256(out + 3, v);
+		}
+		for (; i + 8 <= count; i += 8, out++)
+		{
+			_mm256_storeu_si256(out, v);
+		}
+		fill32Scalar(out, value, count - i);
+	}
+#endif
+
+	static Fill32Func selectFill32()
+	{
+#if SOFTGL_SIMD_X86
+		switch (SIMD::getLevel())
+		{
+		case SIMDLevel::SIMD_AVX2: return &fill32AVX2;
+		case SIMDLevel::SIMD_SSE41: return &fill32SSE41;
+		default: break;
+		}
+#endif
+		return &fill32Scalar;
+	}
+
+	static const Fill32Func fill32 = selectFill32();
+
+	FrameBuffer::FrameBuffer(uint32_t width, uint32_t height, FrameBufferLayout layout, uint32_t sampleCount)
+		:mLayout(layout), mSampleCount(sampleCount > 1 ? SOFTGL_MAX_SAMPLES : 1), mWidth(width), mHeight(height)
 	{
 		assert(width > 0 && height > 0);
 
-		mColorBuffer.resize(mWidth * mHeight * 4, 255);
-		mDepthBuffer.resize(mWidth * mHeight, 1.0f);
+		mHiZWidth = (mWidth + SOFTGL_HIZ_TILE_SIZE - 1) / SOFTGL_HIZ_TILE_SIZE;
+		mHiZHeight = (mHeight + SOFTGL_HIZ_TILE_SIZE - 1) / SOFTGL_HIZ_TILE_SIZE;
+		mHiZMin.resize(mHiZWidth * mHiZHeight, 0.0f);
+		mHiZMax.resize(mHiZWidth * mHiZHeight, 0.0f);
+		mHiZDirty.resize(mHiZWidth * mHiZHeight, 0);
+
+		// the tiled layout pads the edge tiles
+		const uint32_t pixelCount = mLayout == FrameBufferLayout::TILED ? mHiZWidth * mHiZHeight * SOFTGL_HIZ_TILE_SIZE * SOFTGL_HIZ_TILE_SIZE : mWidth * mHeight;
+		mColorBuffer.resize(static_cast<size_t>(pixelCount) * mSampleCount * 4, 0);
+		mDepthBuffer.resize(static_cast<size_t>(pixelCount) * mSampleCount, 0.0f);
 
-		std::fill(mColorBuffer.begin(), mColorBuffer.end(), 0);
-		std::fill(mDepthBuffer.begin(), mDepthBuffer.end(), 0.0f);
+		if (mSampleCount > 1)
+		{
+			mLinearColorBuffer.resize(static_cast<size_t>(mWidth) * mHeight * 4, 0);
+		}
+
+		mColorClearPending.resize(mHiZWidth * mHiZHeight, 0);
+		mDepthClearPending.resize(mHiZWidth * mHiZHeight, 0);
 	}
 
 	FrameBuffer::~FrameBuffer()
@@ -28,66 +117,332 @@ namespace SoftRenderer
 
 	void FrameBuffer::clearColor(float r, float g, float b, float a)
 	{
-        const uint32_t numPixel = mWidth * mHeight;
+		// tiles are filled on their first write or on readback
+		mClearColor = packColor(glm::vec4(r, g, b, a));
+		std::fill(mColorClearPending.begin(), mColorClearPending.end(), 1);
+	}
+
+	void FrameBuffer::clearDepth(float depth)
+	{
+		mClearDepth = depth;
+		std::fill(mDepthClearPending.begin(), mDepthClearPending.end(), 1);
+
+		clearHiZ(depth);
+	}
 
-        for (uint32_t i = 0; i < numPixel; ++i) 
+	void FrameBuffer::clear(const glm::vec4& color, float depth)
+	{
+		clearColor(color);
+		clearDepth(depth);
+	}
+
+	void FrameBuffer::clearHiZ(float depth)
+	{
+		std::fill(mHiZMin.begin(), mHiZMin.end(), depth);
+		std::fill(mHiZMax.begin(), mHiZMax.end(), depth);
+		std::fill(mHiZDirty.begin(), mHiZDirty.end(), 0);
+	}
+
+	unsigned char* FrameBuffer::getColorBuffer()
+	{
+		if (mSampleCount > 1)
+			return mLinearColorBuffer.data();
+
+		resolveColor();
+		if (mLayout == FrameBufferLayout::LINEAR)
+			return mColorBuffer.data();
+
+		mLinearColorBuffer.resize(static_cast<size_t>(mWidth) * mHeight * 4);
+		detile(mColorBuffer.data(), mLinearColorBuffer.data());
+		return mLinearColorBuffer.data();
+	}
+
+	float* FrameBuffer::getDepthBuffer()
+	{
+		resolveDepth();
+		if (mLayout == FrameBufferLayout::LINEAR && mSampleCount == 1)
+			return mDepthBuffer.data();
+
+		mLinearDepthBuffer.resize(static_cast<size_t>(mWidth) * mHeight);
+		detile(mDepthBuffer.data(), mLinearDepthBuffer.data());
+		return mLinearDepthBuffer.data();
+	}
+
+	void FrameBuffer::detile(const void* src, void* dst)
+	{
+		const uint8_t* srcBytes = static_cast<const uint8_t*>(src);
+		uint8_t* dstBytes = static_cast<uint8_t*>(dst);
+
+		if (mSampleCount > 1)
+		{
+			for (uint32_t y = 0; y < mHeight; ++y)
+			{
+				for (uint32_t x = 0; x < mWidth; ++x)
+				{
+					std::memcpy(dstBytes + (static_cast<uint64_t>(y) * mWidth + x) * 4, srcBytes + static_cast<uint64_t>(sampleIndex(x, y)) * 4, 4);
+				}
+			}
+			return;
+		}
+
+		// the 4 pixels of a block row are contiguous
+		for (uint32_t y = 0; y < mHeight; ++y)
 		{
-            mColorBuffer[static_cast<uint64_t>(i) * 4 + 0] = static_cast<unsigned char>(255 * glm::clamp<float>(r, 0.0f, 1.0f));
-            mColorBuffer[static_cast<uint64_t>(i) * 4 + 1] = static_cast<unsigned char>(255 * glm::clamp<float>(g, 0.0f, 1.0f));
-            mColorBuffer[static_cast<uint64_t>(i) * 4 + 2] = static_cast<unsigned char>(255 * glm::clamp<float>(b, 0.0f, 1.0f));
-            mColorBuffer[static_cast<uint64_t>(i) * 4 + 3] = static_cast<unsigned char>(255 * glm::clamp<float>(a, 0.0f, 1.0f));
-        }
+			for (uint32_t x = 0; x < mWidth; x += 4)
+			{
+				const uint32_t count = std::min(4u, mWidth - x);
+				std::memcpy(dstBytes + (static_cast<uint64_t>(y) * mWidth + x) * 4, srcBytes + static_cast<uint64_t>(pixelIndex(x, y)) * 4, count * 4);
+			}
+		}
 	}
 
-	void FrameBuffer::clearDepth(float depth)
+	void FrameBuffer::resolveSamples()
+	{
+		if (mSampleCount == 1)
+			return;
+
+		resolveColor();
+
+		for (uint32_t y = 0; y < mHeight; ++y)
+		{
+			for (uint32_t x = 0; x < mWidth; ++x)
+			{
+				const uint8_t* samples = mColorBuffer.data() + static_cast<uint64_t>(sampleIndex(x, y)) * 4;
+				uint8_t* resolved = mLinearColorBuffer.data() + (static_cast<uint64_t>(y) * mWidth + x) * 4;
+
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					uint32_t sum = 0;
+					for (uint32_t s = 0; s < mSampleCount; ++s)
+					{
+						sum += samples[s * 4 + c];
+					}
+					resolved[c] = static_cast<uint8_t>((sum + mSampleCount / 2) / mSampleCount);
+				}
+			}
+		}
+	}
+
+	void FrameBuffer::resolveColor()
+	{
+		for (uint32_t tileIndex = 0; tileIndex < mColorClearPending.size(); ++tileIndex)
+		{
+			if (mColorClearPending[tileIndex])
+			{
+				resolveColorTile(tileIndex);
+			}
+		}
+	}
+
+	void FrameBuffer::resolveDepth()
+	{
+		for (uint32_t tileIndex = 0; tileIndex < mDepthClearPending.size(); ++tileIndex)
+		{
+			if (mDepthClearPending[tileIndex])
+			{
+				resolveDepthTile(tileIndex);
+			}
+		}
+	}
+
+	void FrameBuffer::resolveColorTile(uint32_t tileIndex)
+	{
+		fillTile(mColorBuffer.data(), mClearColor, tileIndex);
+		mColorClearPending[tileIndex] = 0;
+	}
+
+	void FrameBuffer::resolveDepthTile(uint32_t tileIndex)
+	{
+		uint32_t depthBits;
+		std::memcpy(&depthBits, &mClearDepth, 4);
+
+		fillTile(mDepthBuffer.data(), depthBits, tileIndex);
+		mDepthClearPending[tileIndex] = 0;
+	}
+
+	void FrameBuffer::fillTile(void* buffer, uint32_t value, uint32_t tileIndex)
 	{
-		const uint32_t numPixel = mWidth * mHeight;
+		// color and depth pixels are both 4 bytes
+		uint8_t* bytes = static_cast<uint8_t*>(buffer);
+
+		if (mLayout == FrameBufferLayout::TILED)
+		{
+			const uint32_t tileSamples = SOFTGL_HIZ_TILE_SIZE * SOFTGL_HIZ_TILE_SIZE * mSampleCount;
+			fill32(bytes + static_cast<uint64_t>(tileIndex) * tileSamples * 4, value, tileSamples);
+			return;
+		}
 
-		for (uint32_t i = 0; i < numPixel; ++i)
+		const uint32_t startX = (tileIndex % mHiZWidth) * SOFTGL_HIZ_TILE_SIZE;
+		const uint32_t startY = (tileIndex / mHiZWidth) * SOFTGL_HIZ_TILE_SIZE;
+		const uint32_t endX = std::min(startX + SOFTGL_HIZ_TILE_SIZE, mWidth);
+		const uint32_t endY = std::min(startY + SOFTGL_HIZ_TILE_SIZE, mHeight);
+
+		for (uint32_t y = startY; y < endY; ++y)
 		{
-			mDepthBuffer[i] = depth;
+			fill32(bytes + static_cast<uint64_t>(sampleIndex(startX, y)) * 4, value, (endX - startX) * mSampleCount);
 		}
 	}
 
+	uint32_t FrameBuffer::packColor(const glm::vec4& color)
+	{
+		const uint8_t rgba[4] =
+		{
+			static_cast<uint8_t>(255 * glm::clamp<float>(color.r, 0.0f, 1.0f)),
+			static_cast<uint8_t>(255 * glm::clamp<float>(color.g, 0.0f, 1.0f)),
+			static_cast<uint8_t>(255 * glm::clamp<float>(color.b, 0.0f, 1.0f)),
+			static_cast<uint8_t>(255 * glm::clamp<float>(color.a, 0.0f, 1.0f)),
+		};
+
+		uint32_t packed;
+		std::memcpy(&packed, rgba, 4);
+		return packed;
+	}
+
 	void FrameBuffer::writeColor(uint32_t x, uint32_t y, const glm::vec4& color)
+	{
+		writeColorSamples(x, y, color, (1u << mSampleCount) - 1);
+	}
+
+	void FrameBuffer::writeDepth(uint32_t x, uint32_t y, float depth)
+	{
+		for (uint32_t s = 0; s < mSampleCount; ++s)
+		{
+			writeDepthSample(x, y, s, depth);
+		}
+	}
+
+	float FrameBuffer::getDepth(uint32_t x, uint32_t y)
+	{
+		return getDepthSample(x, y, 0);
+	}
+
+	glm::vec4 FrameBuffer::getColor(uint32_t x, uint32_t y)
+	{
+        if (x < 0 || y < 0 || x >= mWidth || y >= mHeight)
+            return glm::vec4(0.0f);
+
+		if (mColorClearPending[tileIndexOf(x, y)])
+		{
+			const uint8_t* rgba = reinterpret_cast<const uint8_t*>(&mClearColor);
+			return glm::vec4(rgba[0], rgba[1], rgba[2], rgba[3]);
+		}
+
+		const uint8_t* rgba = mColorBuffer.data() + static_cast<uint64_t>(sampleIndex(x, y)) * 4;
+		return glm::vec4(rgba[0], rgba[1], rgba[2], rgba[3]);
+	}
+
+	void FrameBuffer::writeColorSamples(uint32_t x, uint32_t y, const glm::vec4& color, uint32_t sampleMask)
 	{
 		if (x < 0 || y < 0 || x >= mWidth || y >= mHeight)
 			return;
 
-		const uint32_t index = y * mWidth + x;
-        mColorBuffer[static_cast<uint64_t>(index) * 4 + 0] = static_cast<uint8_t>(255 * color.x);
-        mColorBuffer[static_cast<uint64_t>(index) * 4 + 1] = static_cast<uint8_t>(255 * color.y);
-        mColorBuffer[static_cast<uint64_t>(index) * 4 + 2] = static_cast<uint8_t>(255 * color.z);
-        mColorBuffer[static_cast<uint64_t>(index) * 4 + 3] = static_cast<uint8_t>(255 * color.w);
+		const uint32_t tileIndex = tileIndexOf(x, y);
+		if (mColorClearPending[tileIndex])
+		{
+			resolveColorTile(tileIndex);
+		}
 
+		const uint8_t rgba[4] =
+		{
+			static_cast<uint8_t>(255 * color.x),
+			static_cast<uint8_t>(255 * color.y),
+			static_cast<uint8_t>(255 * color.z),
+			static_cast<uint8_t>(255 * color.w),
+		};
+
+		uint8_t* samples = mColorBuffer.data() + static_cast<uint64_t>(sampleIndex(x, y)) * 4;
+		for (uint32_t s = 0; s < mSampleCount; ++s)
+		{
+			if (sampleMask & (1u << s))
+			{
+				std::memcpy(samples + s * 4, rgba, 4);
+			}
+		}
 	}
 
-	void FrameBuffer::writeDepth(uint32_t x, uint32_t y, float depth)
+	void FrameBuffer::writeDepthSample(uint32_t x, uint32_t y, uint32_t sample, float depth)
 	{
 		if (x < 0 || y < 0 || x >= mWidth || y >= mHeight)
 			return;
 
-		const uint32_t index = y * mWidth + x;
-		mDepthBuffer[index] = depth;
+		const uint32_t tileIndex = tileIndexOf(x, y);
+		if (mDepthClearPending[tileIndex])
+		{
+			resolveDepthTile(tileIndex);
+		}
+
+		mDepthBuffer[sampleIndex(x, y) + sample] = depth;
+
+		// widen the tile bounds, updateHiZ tightens them again
+		mHiZMin[tileIndex] = std::min(mHiZMin[tileIndex], depth);
+		mHiZMax[tileIndex] = std::max(mHiZMax[tileIndex], depth);
+		mHiZDirty[tileIndex] = 1;
 	}
 
-	float FrameBuffer::getDepth(uint32_t x, uint32_t y)
+	float FrameBuffer::getDepthSample(uint32_t x, uint32_t y, uint32_t sample)
 	{
         if (x < 0 || y < 0 || x >= mWidth || y >= mHeight)
             return 0.0f;
 
-		const uint32_t index = y * mWidth + x;
-		return mDepthBuffer[index];
+		// reads do not resolve, a cleared tile holds the clear depth
+		if (mDepthClearPending[tileIndexOf(x, y)])
+			return mClearDepth;
+
+		return mDepthBuffer[sampleIndex(x, y) + sample];
 	}
 
-	glm::vec4 FrameBuffer::getColor(uint32_t x, uint32_t y)
+	void FrameBuffer::updateHiZ(uint32_t tileX, uint32_t tileY)
 	{
-        if (x < 0 || y < 0 || x >= mWidth || y >= mHeight)
-            return glm::vec4(0.0f);
+		const uint32_t startX = tileX * SOFTGL_HIZ_TILE_SIZE;
+		const uint32_t startY = tileY * SOFTGL_HIZ_TILE_SIZE;
+		const uint32_t endX = std::min(startX + SOFTGL_HIZ_TILE_SIZE, mWidth);
+		const uint32_t endY = std::min(startY + SOFTGL_HIZ_TILE_SIZE, mHeight);
+
+		const uint32_t tileIndex = tileY * mHiZWidth + tileX;
+		if (!mHiZDirty[tileIndex])
+		{
+			return;
+		}
+		mHiZDirty[tileIndex] = 0;
+
+		if (mDepthClearPending[tileIndex])
+		{
+			mHiZMin[tileIndex] = mClearDepth;
+			mHiZMax[tileIndex] = mClearDepth;
+			return;
+		}
 
-		const uint32_t index = y * mWidth + x;
-		const glm::vec4 color = glm::vec4(mColorBuffer[static_cast<uint64_t>(index) * 4 + 0], mColorBuffer[static_cast<uint64_t>(index) * 4 + 1], mColorBuffer[static_cast<uint64_t>(index) * 4 + 2], mColorBuffer[static_cast<uint64_t>(index) * 4 + 3]);
+		float minDepth = mDepthBuffer[sampleIndex(startX, startY)];
+		float maxDepth = minDepth;
+		for (uint32_t y = startY; y < endY; ++y)
+		{
+			for (uint32_t x = startX; x < endX; ++x)
+			{
+				const float* samples = mDepthBuffer.data() + sampleIndex(x, y);
+				for (uint32_t s = 0; s < mSampleCount; ++s)
+				{
+					minDepth = std::min(minDepth, samples[s]);
+					maxDepth = std::max(maxDepth, samples[s]);
+				}
+			}
+		}
+
+		mHiZMin[tileIndex] = minDepth;
+		mHiZMax[tileIndex] = maxDepth;
+	}
+
+	bool FrameBuffer::saveColorBuffer(const std::string& filename)
+	{
+		const uint8_t* colorBuffer = getColorBuffer();
+		const uint32_t rowSize = mWidth * 4;
+
+		std::vector<uint8_t> flipped(static_cast<size_t>(rowSize) * mHeight);
+		for (uint32_t y = 0; y < mHeight; ++y)
+		{
+			std::memcpy(flipped.data() + static_cast<uint64_t>(mHeight - 1 - y) * rowSize, colorBuffer + static_cast<uint64_t>(y) * rowSize, rowSize);
+		}
 
-		return color;
+		auto image = Image::create(mWidth, mHeight, Image::PixelFormat::PF_RGBA8888, flipped);
+		return image->save(filename, Image::PNG);
 	}
 }
\ No newline at end of file
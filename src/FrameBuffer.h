@@ -2,40 +2,138 @@
 
 #include <vector>
 #include <memory>
+#include <string>
 
 #include "MathUtils.h"
 
+#define SOFTGL_HIZ_TILE_SIZE 16
+#define SOFTGL_MAX_SAMPLES 4
+
 namespace SoftRenderer
 {
+	enum class FrameBufferLayout
+	{
+		LINEAR,
+
+		// pixels of a Hi-Z tile are stored together as 4x4 blocks, so a 2x2 quad lies in one 64 byte block
+		TILED,
+	};
+
 	class FrameBuffer
 	{
 	public:
 		using Ptr = std::shared_ptr<FrameBuffer>;
 
-		FrameBuffer(uint32_t width, uint32_t height);
+		// sampleCount 1 or SOFTGL_MAX_SAMPLES, the samples of a pixel are stored next to each other
+		FrameBuffer(uint32_t width, uint32_t height, FrameBufferLayout layout = FrameBufferLayout::LINEAR, uint32_t sampleCount = 1);
 		~FrameBuffer();
 
 		uint32_t getWidth() { return mWidth; }
 		uint32_t getHeight() { return mHeight; }
 
-		unsigned char* getColorBuffer() { return mColorBuffer.data(); }
-		float* getDepthBuffer() { return mDepthBuffer.data(); }
+		FrameBufferLayout getLayout() { return mLayout; }
+
+		uint32_t getSampleCount() { return mSampleCount; }
+
+		// readback resolves the tiles whose clear is still pending, the tiled layout returns a linear copy.
+		// Multisampled buffers return the colors of the last resolveSamples and the depth of sample 0
+		unsigned char* getColorBuffer();
+		float* getDepthBuffer();
 
+		// averages the samples of every pixel into the color getColorBuffer returns
+		void resolveSamples();
+
+		// clears are lazy: every tile only records that it holds the clear value, and is filled on its first write
 		void clearColor(const glm::vec4& color);
 		void clearColor(float r, float g, float b, float a);
 		void clearDepth(float depth);
+		void clear(const glm::vec4& color, float depth);
+
+		// RGBA8 value that clearColor writes for color
+		static uint32_t packColor(const glm::vec4& color);
 
+		// pixel access writes every sample and reads sample 0
 		void writeColor(uint32_t x, uint32_t y, const glm::vec4& color);
 		void writeDepth(uint32_t x, uint32_t y, float depth);
 
 		float getDepth(uint32_t x, uint32_t y);
 		glm::vec4 getColor(uint32_t x, uint32_t y);
 
+		void writeColorSamples(uint32_t x, uint32_t y, const glm::vec4& color, uint32_t sampleMask);
+		void writeDepthSample(uint32_t x, uint32_t y, uint32_t sample, float depth);
+		float getDepthSample(uint32_t x, uint32_t y, uint32_t sample);
+
+		// Hi-Z: per tile bounds of the depth buffer, min is a lower bound and max an upper bound of every depth in the tile
+		uint32_t getHiZWidth() { return mHiZWidth; }
+		uint32_t getHiZHeight() { return mHiZHeight; }
+
+		float getHiZMin(uint32_t tileX, uint32_t tileY) { return mHiZMin[tileY * mHiZWidth + tileX]; }
+		float getHiZMax(uint32_t tileX, uint32_t tileY) { return mHiZMax[tileY * mHiZWidth + tileX]; }
+
+		// recompute the exact bounds of a tile from the depth buffer, if depth writes widened them since the last update
+		void updateHiZ(uint32_t tileX, uint32_t tileY);
+
+		// Write the color buffer to a PNG file, rows are flipped so that the image is top-down
+		bool saveColorBuffer(const std::string& filename);
+
+	private:
+		void clearHiZ(float depth);
+
+		void resolveColor();
+		void resolveDepth();
+		void resolveColorTile(uint32_t tileIndex);
+		void resolveDepthTile(uint32_t tileIndex);
+		void fillTile(void* buffer, uint32_t value, uint32_t tileIndex);
+
+		// copies sample 0 of the 4 byte pixels to rows
+		void detile(const void* src, void* dst);
+
+		inline uint32_t sampleIndex(uint32_t x, uint32_t y) const
+		{
+			return pixelIndex(x, y) * mSampleCount;
+		}
+
+		inline uint32_t tileIndexOf(uint32_t x, uint32_t y) const
+		{
+			return (y / SOFTGL_HIZ_TILE_SIZE) * mHiZWidth + x / SOFTGL_HIZ_TILE_SIZE;
+		}
+
+		inline uint32_t pixelIndex(uint32_t x, uint32_t y) const
+		{
+			if (mLayout == FrameBufferLayout::LINEAR)
+				return y * mWidth + x;
+
+			const uint32_t tileIndex = (y / SOFTGL_HIZ_TILE_SIZE) * mHiZWidth + x / SOFTGL_HIZ_TILE_SIZE;
+			const uint32_t inTileX = x & (SOFTGL_HIZ_TILE_SIZE - 1);
+			const uint32_t inTileY = y & (SOFTGL_HIZ_TILE_SIZE - 1);
+			const uint32_t blockIndex = (inTileY >> 2) * (SOFTGL_HIZ_TILE_SIZE / 4) + (inTileX >> 2);
+
+			return tileIndex * SOFTGL_HIZ_TILE_SIZE * SOFTGL_HIZ_TILE_SIZE + blockIndex * 16 + (inTileY & 3) * 4 + (inTileX & 3);
+		}
 
 	private:
 		std::vector<uint8_t> mColorBuffer;
 		std::vector<float> mDepthBuffer;
 
+		// linear copies handed out by the readback of the tiled layout, and the resolved samples
+		std::vector<uint8_t> mLinearColorBuffer;
+		std::vector<float> mLinearDepthBuffer;
+		FrameBufferLayout mLayout;
+		uint32_t mSampleCount;
+
+		std::vector<float> mHiZMin;
+		std::vector<float> mHiZMax;
+		// non zero once a depth write widened the bounds of the tile
+		std::vector<uint8_t> mHiZDirty;
+		uint32_t mHiZWidth;
+		uint32_t mHiZHeight;
+
+		// fast clear state per Hi-Z tile, non zero while the tile still has to be filled with the clear value
+		std::vector<uint8_t> mColorClearPending;
+		std::vector<uint8_t> mDepthClearPending;
+		uint32_t mClearColor = 0;
+		float mClearDepth = 0.0f;
+
 		uint32_t mWidth;
 		uint32_t mHeight;
 	};
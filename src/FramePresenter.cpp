@@ -0,0 +1,74 @@
+#include "FramePresenter.h"
+
+#include <algorithm>
+
+namespace SoftRenderer
+{
+    FramePresenter::FramePresenter(PresentFunc presentFunc)
+        : mPresentFunc(std::move(presentFunc))
+    {
+        mThread = std::thread(&FramePresenter::run, this);
+    }
+
+    FramePresenter::~FramePresenter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mExit = true;
+        }
+        mCondition.notify_all();
+
+        mThread.join();
+    }
+
+    void FramePresenter::present(const FrameBuffer::Ptr& frameBuffer)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mQueue.push_back(frameBuffer);
+        }
+        mCondition.notify_all();
+    }
+
+    bool FramePresenter::isInFlight(const FrameBuffer* frameBuffer)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return std::any_of(mQueue.begin(), mQueue.end(), [frameBuffer](const FrameBuffer::Ptr& queued) { return queued.get() == frameBuffer; });
+    }
+
+    void FramePresenter::waitForFrame()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        const uint64_t presentedCount = mPresentedCount;
+        mCondition.wait(lock, [&] { return mQueue.empty() || mPresentedCount != presentedCount; });
+    }
+
+    void FramePresenter::waitIdle()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [&] { return mQueue.empty(); });
+    }
+
+    void FramePresenter::run()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (true)
+        {
+            mCondition.wait(lock, [&] { return mExit || !mQueue.empty(); });
+            if (mQueue.empty())
+            {
+                return;
+            }
+
+            // the frame stays queued while it is presented, so the renderer does not reuse it
+            FrameBuffer::Ptr frameBuffer = mQueue.front();
+            lock.unlock();
+            mPresentFunc(frameBuffer);
+            lock.lock();
+
+            mQueue.pop_front();
+            mPresentedCount++;
+            mCondition.notify_all();
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "FrameBuffer.h"
+
+namespace SoftRenderer
+{
+    /**
+     * Runs the present callback (display, encode, save...) of swapped frames on its own thread,
+     * so the renderer can start the next frame while the previous one is still being presented.
+     * Frames are presented in swap order.
+     */
+    class FramePresenter
+    {
+    public:
+        using PresentFunc = std::function<void(const FrameBuffer::Ptr&)>;
+
+        explicit FramePresenter(PresentFunc presentFunc);
+
+        // presents the frames still queued before returning
+        ~FramePresenter();
+
+        FramePresenter(const FramePresenter&) = delete;
+        FramePresenter& operator=(const FramePresenter&) = delete;
+
+        void present(const FrameBuffer::Ptr& frameBuffer);
+
+        // true while the frame is queued or being presented, it must not be rendered to then
+        bool isInFlight(const FrameBuffer* frameBuffer);
+
+        // blocks until the next frame finished presenting, returns at once if none is in flight
+        void waitForFrame();
+
+        void waitIdle();
+
+    private:
+        void run();
+
+    private:
+        PresentFunc mPresentFunc;
+
+        std::mutex mMutex;
+        std::condition_variable mCondition;
+
+        // the front frame is the one being presented, it is popped once done
+        std::deque<FrameBuffer::Ptr> mQueue;
+        uint64_t mPresentedCount = 0;
+        bool mExit = false;
+
+        std::thread mThread;
+    };
+}
@@ -5,6 +5,9 @@
 #include <array>
 
 #include "Utils.h"
+#include "CommandBuffer.h"
+#include "EdgeCoverage.h"
+#include "VaryingInterpolation.h"
 
 namespace SoftRenderer
 {
@@ -19,8 +22,12 @@ namespace SoftRenderer
         NEGATIVE_Z = 1 << 5,
         NEAR = 1 << 6,
         FAR  = 1 << 7,  
+        GUARD_BAND = 1 << 8,    // outside the x/y guard band, the triangle needs x/y clipping too
     };
 
+    const uint32_t frustumClipMaskPlanes = POSITIVE_X | NEGATIVE_X | POSITIVE_Y | NEGATIVE_Y | POSITIVE_Z | NEGATIVE_Z;
+    const uint32_t frustumClipMaskZ = POSITIVE_Z | NEGATIVE_Z;
+
     const uint32_t frustumClipMaskArray[6] = 
     {
         FrustumClipMask::POSITIVE_X,
@@ -31,14 +38,31 @@ namespace SoftRenderer
         FrustumClipMask::NEGATIVE_Z
     };
 
-    void Graphics::init(int width, int height)
+    static uint32_t calculateFrustumClipMask(const glm::vec4& clip_pos, const glm::vec2& guardBand)
+    {
+        uint32_t mask = 0;
+        if (clip_pos.w < clip_pos.x) mask |= FrustumClipMask::POSITIVE_X;
+        if (clip_pos.w < -clip_pos.x) mask |= FrustumClipMask::NEGATIVE_X;
+        if (clip_pos.w < clip_pos.y) mask |= FrustumClipMask::POSITIVE_Y;
+        if (clip_pos.w < -clip_pos.y) mask |= FrustumClipMask::NEGATIVE_Y;
+        if (clip_pos.w < clip_pos.z) mask |= FrustumClipMask::POSITIVE_Z;
+        if (clip_pos.w < -clip_pos.z) mask |= FrustumClipMask::NEGATIVE_Z;
+        if (clip_pos.w * guardBand.x < std::abs(clip_pos.x) || clip_pos.w * guardBand.y < std::abs(clip_pos.y)) mask |= FrustumClipMask::GUARD_BAND;
+        //if (clip_pos.w > far) mask |= FrustumClipMask::FAR;
+        //if (clip_pos.w < near) mask |= FrustumClipMask::NEAR;
+        return mask;
+    }
+
+    void Graphics::init(int width, int height, FrameBufferLayout layout, uint32_t sampleCount)
     {
         mWidth = width;
         mHeight = height;
+        mFrameBufferLayout = layout;
 
         // create back buffer
-        mFrontBuffer = std::make_shared<FrameBuffer>(width, height);
-        mBackBuffer = std::make_shared<FrameBuffer>(width, height);
+        mFrontBuffer = std::make_shared<FrameBuffer>(width, height, layout, sampleCount);
+        mBackBuffer = std::make_shared<FrameBuffer>(width, height, layout, sampleCount);
+        mSampleCount = mBackBuffer->getSampleCount();
 
 
 
@@ -51,6 +75,12 @@ namespace SoftRenderer
         //mShader->mUniforms.albedo = albedo;
 
         mFragmentQuad.resize(mThreadPool.get_thread_count() + 1);
+
+        mThreadIdMap = mThreadPool.get_thread_id_map();
+        mThreadPrograms.resize(mFragmentQuad.size());
+
+        mTileCountX = (width + SOFTGL_TILE_SIZE - 1) / SOFTGL_TILE_SIZE;
+        mTileCountY = (height + SOFTGL_TILE_SIZE - 1) / SOFTGL_TILE_SIZE;
     }
 
     void Graphics::setViewport(int32_t x, int32_t y, int32_t width, int32_t height)
@@ -60,6 +90,10 @@ namespace SoftRenderer
         mViewport.y = 0;
         mViewport.width  = (float)width;
         mViewport.height = (float)height;
+
+        // ndc extent that keeps screen coordinates within [-SOFTGL_GUARD_BAND_SIZE, SOFTGL_GUARD_BAND_SIZE]
+        mGuardBand.x = std::max((SOFTGL_GUARD_BAND_SIZE - std::abs(mViewport.x) - mViewport.width) * 2.0f / mViewport.width + 1.0f, 1.0f);
+        mGuardBand.y = std::max((SOFTGL_GUARD_BAND_SIZE - std::abs(mViewport.y) - mViewport.height) * 2.0f / mViewport.height + 1.0f, 1.0f);
     }
 
     void Graphics::clear(float r, float g, float b, float a)
@@ -122,20 +156,166 @@ namespace SoftRenderer
         for (const auto subMesh : mesh->subMeshs)
         {
             if (subMesh->indices.empty() || subMesh->vertices.empty())
-                return;
+                continue;
 
-            uploadVertexData(subMesh->vertices, subMesh->indices);
-            processVertexShader();
-            processFrustumClip();
-            processPerspectiveDivide();
-            processViewportTransform();
-            processBackFaceCulling();
+            drawSubMesh(subMesh.get());
+        }
+    }
 
-            processRasterization();
-            //ProcessFaceWireframe();
+    void Graphics::drawMesh1(const Mesh* mesh, const glm::mat4& modelViewProject)
+    {
+        if (mesh->subMeshs.size() > 1 && isBoundsCulled(mesh->mBounds, modelViewProject))
+            return;
+
+        for (const auto subMesh : mesh->subMeshs)
+        {
+            if (subMesh->indices.empty() || subMesh->vertices.empty())
+                continue;
+
+            if (isBoundsCulled(subMesh->bounds, modelViewProject))
+                continue;
+
+            drawSubMesh(subMesh.get());
         }
     }
-    
+
+    void Graphics::drawSubMesh(const SubMesh* subMesh, uint32_t firstIndex, uint32_t indexCount)
+    {
+        if (!uploadSubMesh(subMesh, firstIndex, indexCount))
+            return;
+
+        processVertexShader();
+        processFrustumClip();
+        processBackFaceCulling();
+
+        processRasterization();
+        //ProcessFaceWireframe();
+    }
+
+    void Graphics::drawMeshInstanced(const Mesh* mesh, uint32_t instanceCount, const void* instanceData, size_t instanceDataStride)
+    {
+        for (const auto subMesh : mesh->subMeshs)
+        {
+            // vertex fetch, faces and the shade list are set up once and shared by every instance
+            if (!uploadSubMesh(subMesh.get(), 0, UINT32_MAX))
+                continue;
+
+            const uint32_t vertexCount = mRenderContex.vertexCount;
+            mInstanceFaces.assign(mRenderContex.faceBuffer.begin(), mRenderContex.faceBuffer.end());
+
+            for (uint32_t instance = 0; instance < instanceCount; instance++)
+            {
+                // drop the clip vertices and faces of the previous instance
+                if (instance > 0)
+                {
+                    mRenderContex.vertexCount = vertexCount;
+                    mRenderContex.faceBuffer.assign(mInstanceFaces.begin(), mInstanceFaces.end());
+                }
+
+                mInstanceID = instance;
+                mInstanceData = instanceData ? static_cast<const uint8_t*>(instanceData) + instance * instanceDataStride : nullptr;
+
+                processVertexShader();
+                processFrustumClip();
+                processBackFaceCulling();
+
+                processRasterization();
+            }
+        }
+
+        mInstanceID = 0;
+        mInstanceData = nullptr;
+    }
+
+    bool Graphics::uploadSubMesh(const SubMesh* subMesh, uint32_t firstIndex, uint32_t indexCount)
+    {
+        const BufferObject* buffer = getBuffer(subMesh->bufferId);
+        const auto& vertices = buffer ? buffer->vertices : subMesh->vertices;
+        const auto& indices = buffer ? buffer->indices : subMesh->indices;
+
+        if (firstIndex >= indices.size() || vertices.empty())
+            return false;
+
+        indexCount = std::min<uint32_t>(indexCount, (uint32_t)indices.size() - firstIndex);
+
+        if (buffer)
+            uploadBufferData(*buffer, firstIndex, indexCount);
+        else
+            uploadVertexData(vertices, indices.data() + firstIndex, indexCount);
+
+        return true;
+    }
+
+    uint32_t Graphics::createBuffer(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+    {
+        auto buffer = std::make_unique<BufferObject>();
+        buffer->vertices = vertices;
+        buffer->indices = indices;
+
+        buffer->faces.resize(indices.size() / 3);
+        for (size_t i = 0; i < buffer->faces.size(); i++)
+        {
+            buffer->faces[i].indices[0] = indices[i * 3 + 0];
+            buffer->faces[i].indices[1] = indices[i * 3 + 1];
+            buffer->faces[i].indices[2] = indices[i * 3 + 2];
+        }
+
+        std::vector<bool> referenced(vertices.size(), false);
+        for (uint32_t index : indices)
+        {
+            if (!referenced[index])
+            {
+                referenced[index] = true;
+                buffer->shadeList.push_back(index);
+            }
+        }
+
+        // reuse the slot of a deleted buffer
+        auto slot = std::find(mBuffers.begin(), mBuffers.end(), nullptr);
+        if (slot == mBuffers.end())
+        {
+            mBuffers.push_back(std::move(buffer));
+            return (uint32_t)mBuffers.size();
+        }
+
+        *slot = std::move(buffer);
+        return (uint32_t)(slot - mBuffers.begin()) + 1;
+    }
+
+    void Graphics::deleteBuffer(uint32_t bufferId)
+    {
+        if (bufferId > 0 && bufferId <= mBuffers.size())
+        {
+            mBuffers[bufferId - 1].reset();
+        }
+    }
+
+    void Graphics::createBuffers(Mesh* mesh)
+    {
+        for (auto& subMesh : mesh->subMeshs)
+        {
+            deleteBuffer(subMesh->bufferId);
+            subMesh->bufferId = createBuffer(subMesh->vertices, subMesh->indices);
+        }
+    }
+
+    void Graphics::deleteBuffers(Mesh* mesh)
+    {
+        for (auto& subMesh : mesh->subMeshs)
+        {
+            deleteBuffer(subMesh->bufferId);
+            subMesh->bufferId = 0;
+        }
+    }
+
+    const Graphics::BufferObject* Graphics::getBuffer(uint32_t bufferId) const
+    {
+        if (bufferId == 0 || bufferId > mBuffers.size())
+            return nullptr;
+
+        return mBuffers[bufferId - 1].get();
+    }
+
     void Graphics::clearColor(const glm::vec4& color)
     {
         mBackBuffer->clearColor(color);
@@ -146,11 +326,29 @@ namespace SoftRenderer
         mBackBuffer->clearDepth(depth);
     }
 
+    void Graphics::clearColorDepth(const glm::vec4& color, float depth)
+    {
+        mBackBuffer->clear(color, depth);
+    }
+
     void Graphics::swapBuffer()
     {
-        auto tmp = std::move(mFrontBuffer);
-        mFrontBuffer = std::move(mBackBuffer);
-        mBackBuffer = std::move(tmp);
+        mBackBuffer->resolveSamples();
+
+        if (mFramePresenter)
+        {
+            mFrontBuffer = std::move(mBackBuffer);
+            mFramePresenter->present(mFrontBuffer);
+            mBackBuffer = acquireFrameBuffer();
+        }
+        else
+        {
+            auto tmp = std::move(mFrontBuffer);
+            mFrontBuffer = std::move(mBackBuffer);
+            mBackBuffer = std::move(tmp);
+        }
+
+        mFrameArena.reset();
     }
 
     FrameBuffer::Ptr& Graphics::getOutput()
@@ -158,6 +356,54 @@ namespace SoftRenderer
         return mFrontBuffer;
     }
 
+    void Graphics::setFramePresenter(FramePresenter::PresentFunc presentFunc, uint32_t frameCount)
+    {
+        // finishes the frames in flight of the previous presenter
+        mFramePresenter.reset();
+        mFrameRing.clear();
+
+        if (!presentFunc)
+        {
+            return;
+        }
+
+        // front, back and at least one frame in flight
+        frameCount = std::max(frameCount, 3u);
+        mFrameRing.push_back(mBackBuffer);
+        mFrameRing.push_back(mFrontBuffer);
+        while (mFrameRing.size() < frameCount)
+        {
+            mFrameRing.push_back(std::make_shared<FrameBuffer>(mWidth, mHeight, mFrameBufferLayout, mSampleCount));
+        }
+
+        mFramePresenter = std::make_unique<FramePresenter>(std::move(presentFunc));
+    }
+
+    void Graphics::waitFramePresenter()
+    {
+        if (mFramePresenter)
+        {
+            mFramePresenter->waitIdle();
+        }
+    }
+
+    FrameBuffer::Ptr Graphics::acquireFrameBuffer()
+    {
+        while (true)
+        {
+            for (const auto& frameBuffer : mFrameRing)
+            {
+                if (frameBuffer != mFrontBuffer && !mFramePresenter->isInFlight(frameBuffer.get()))
+                {
+                    return frameBuffer;
+                }
+            }
+
+            // every buffer is in flight, wait for the present thread
+            mFramePresenter->waitForFrame();
+        }
+    }
+
     void Graphics::setModelMatrix(const glm::mat4& mat)
     {
         mShader->setModelMatrix(mat);
@@ -221,35 +467,84 @@ namespace SoftRenderer
         //pos.z = 0.5f * (sum + diff * pos.z);
     }
 
-    void Graphics::perspectiveCorrectInterpolation(FragmentQuad& quad)
+    void Graphics::clipToScreen(int32_t index)
     {
-        glm::aligned_vec4* vert = quad.triangularVertexScreenPositionFlat;
+        glm::vec4 position = mRenderContex.clipPositions[index];
+        perspectiveDivide1(position);
+        viewportTransform1(position);
+        mRenderContex.positions[index] = position;
+    }
 
-        for (auto& pixel : quad.pixels) 
+    void Graphics::perspectiveCorrectInterpolation(FragmentQuad& quad, const glm::vec3 edges[4], const glm::vec3* sampleEdgeOffsets)
+    {
+        const glm::vec3 oneDivideClipZ(quad.triangularVertexOneDivideClipZ);
+        const glm::vec3 depth(quad.triangularVertexDepth);
+        const glm::vec3 w(quad.triangularVertexW);
+
+        for (int32_t i = 0; i < 4; i++)
         {
-            auto& bc = pixel.barycentric;
+            auto& pixel = quad.pixels[i];
 
-            // barycentric correction
-            bc /= quad.triangularVertexClipZ;
-            bc /= (bc.x + bc.y + bc.z);
+            // edge functions are affine in screen space, helper pixels extrapolate the same planes
+            const glm::vec3 weights = edges[i] * oneDivideClipZ;
+            const glm::vec3 bc = weights * (1.0f / (weights.x + weights.y + weights.z));
+            pixel.barycentric = glm::aligned_vec4(bc, 0.0f);
 
             // interpolate z, w
-            pixel.position.z = glm::dot(vert[2], bc);
-            pixel.position.w = glm::dot(vert[3], bc);
+            pixel.position.z = glm::dot(depth, bc);
+            pixel.position.w = glm::dot(w, bc);
+
+            if (sampleEdgeOffsets)
+            {
+                for (int32_t s = 0; s < SOFTGL_MAX_SAMPLES; s++)
+                {
+                    const glm::vec3 sampleWeights = (edges[i] + sampleEdgeOffsets[s]) * oneDivideClipZ;
+                    pixel.sampleDepth[s] = glm::dot(depth, sampleWeights) / (sampleWeights.x + sampleWeights.y + sampleWeights.z);
+                }
+            }
+        }
+    }
+
+    void Graphics::varyingInterpolateQuad(FragmentQuad& quad)
+    {
+        float* out[VaryingInterpolation::PIXEL_COUNT];
+        float weights[VaryingInterpolation::PIXEL_COUNT][3];
+        for (int32_t i = 0; i < VaryingInterpolation::PIXEL_COUNT; i++)
+        {
+            const auto& pixel = quad.pixels[i];
+            out[i] = pixel.interpolatedVaryings;
+            weights[i][0] = pixel.barycentric.x;
+            weights[i][1] = pixel.barycentric.y;
+            weights[i][2] = pixel.barycentric.z;
         }
+
+        VaryingInterpolation::interpolateQuad(out, quad.triangularVertexVarings, weights, mRenderContex.varyingsAlignedSize / sizeof(float));
     }
 
-    void Graphics::varyingInterpolate(float* out_vary, const float* in_varyings[], size_t elem_cnt, glm::aligned_vec4& bc) 
+    uint32_t Graphics::depthTestSamples(uint32_t x, uint32_t y, const float* depth, uint32_t sampleMask)
     {
-        const float* in_vary0 = in_varyings[0];
-        const float* in_vary1 = in_varyings[1];
-        const float* in_vary2 = in_varyings[2];
+        if (!mEnableDepthTest)
+            return sampleMask;
 
-        for (int i = 0; i < elem_cnt; i++) 
+        uint32_t passed = 0;
+        for (uint32_t s = 0; s < mSampleCount; s++)
         {
-            auto a = glm::vec4(*(in_vary0 + i), *(in_vary1 + i), *(in_vary2 + i), 1.0f);
-            out_vary[i] = glm::dot(glm::vec4(bc.x, bc.y, bc.z, bc.w), a);
+            if (!(sampleMask & (1u << s)))
+            {
+                continue;
+            }
+
+            if (depthFuncTest(depth[s], mBackBuffer->getDepthSample(x, y, s), mRasterDepthFunc))
+            {
+                if (mRasterDepthMask)
+                {
+                    mBackBuffer->writeDepthSample(x, y, s, depth[s]);
+                }
+                passed |= 1u << s;
+            }
         }
+
+        return passed;
     }
 
     bool Graphics::depthTest(uint32_t x, uint32_t y, float depth)
@@ -261,9 +556,9 @@ namespace SoftRenderer
             return true;
 
         float z = mBackBuffer->getDepth(x, y);
-        if (depthFuncTest(depth, z, mDepthFunc))
+        if (depthFuncTest(depth, z, mRasterDepthFunc))
         {
-            if (mEnableDepthMask)
+            if (mRasterDepthMask)
             {
                 mBackBuffer->writeDepth(x, y, depth);
             }
@@ -521,40 +816,100 @@ namespace SoftRenderer
     
 
 
-    void Graphics::uploadVertexData(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+    void Graphics::uploadVertexData(const std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount)
     {
-        mRenderContex.createVertexBuffer(vertices);
-        mRenderContex.createIndexBuffer(indices);
-        mRenderContex.allocVertexVaringMemory(mProgram->getShaderVaryingsSize() / sizeof(float));
+        mRenderContex.createVertexBuffer(vertices, mProgram->getShaderVaryingsSize() / sizeof(float));
+        mRenderContex.createIndexBuffer(indices, indexCount);
+        buildShadeList(indices, indexCount);
     }
 
-    void Graphics::processVertexShader()
+    void Graphics::uploadBufferData(const BufferObject& buffer, uint32_t firstIndex, uint32_t indexCount)
     {
-        auto vertexShader = mProgram->vertexShader;
+        mRenderContex.createVertexBuffer(buffer.vertices, mProgram->getShaderVaryingsSize() / sizeof(float));
 
-        for (auto& vertex : mRenderContex.vertexBuffer) 
+        // faces are copied since clipping and culling modify them
+        if (firstIndex % 3 == 0)
+        {
+            const auto first = buffer.faces.begin() + firstIndex / 3;
+            mRenderContex.faceBuffer.assign(first, first + indexCount / 3);
+        }
+        else
         {
-            mProgram->bindVertexAttributes(&vertex.vertex);
-            mProgram->bindVertexShaderVaryings(vertex.varyings);
-            //vertexShader->attributes = (BaseShaderAttributes*)&vertex.vertex;
+            mRenderContex.createIndexBuffer(buffer.indices.data() + firstIndex, indexCount);
+        }
 
+        if (firstIndex == 0 && indexCount == buffer.indices.size())
+        {
+            mShadeList = buffer.shadeList.data();
+            mShadeCount = (uint32_t)buffer.shadeList.size();
+        }
+        else
+        {
+            buildShadeList(buffer.indices.data() + firstIndex, indexCount);
+        }
+    }
 
-            //if (vertex.varyings == nullptr)
-            //{
-            //    vertexShader->varyings = nullptr;
-            //}
-            //else 
-            //{
-            //    vertexShader->varyings = (BaseShaderVaryings*)vertex.varyings;
-            //}
+    void Graphics::buildShadeList(const uint32_t* indices, size_t indexCount)
+    {
+        const uint32_t vertexCount = mRenderContex.vertexCount;
+        if (mVertexCacheTags.size() < vertexCount)
+        {
+            mVertexCacheTags.resize(vertexCount, 0);
+        }
 
-            //vertexShader->shaderMain();
+        // a new tag invalidates every cached vertex without clearing the tags
+        if (++mVertexCacheTag == 0)
+        {
+            std::fill(mVertexCacheTags.begin(), mVertexCacheTags.end(), 0);
+            mVertexCacheTag = 1;
+        }
 
-            mProgram->executeVertexShader();
+        uint32_t* shadeList = mFrameArena.allocate<uint32_t>(std::min<size_t>(indexCount, vertexCount) + 1);
+        mShadeCount = 0;
 
-            vertex.position = vertexShader->gl_Position;
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            const uint32_t index = indices[i];
+            if (mVertexCacheTags[index] != mVertexCacheTag)
+            {
+                mVertexCacheTags[index] = mVertexCacheTag;
+                shadeList[mShadeCount++] = index;
+            }
         }
+        mShadeList = shadeList;
+    }
 
+    void Graphics::processVertexShader()
+    {
+        // each worker shades with its own program clone, since binding attributes and varyings mutates the shaders
+        updateThreadPrograms();
+
+        auto& ctx = mRenderContex;
+        const glm::vec2 guardBand = mEnableGuardBand ? mGuardBand : glm::vec2(1.0f);
+
+        mThreadPool.push_loop(mShadeCount, [&](const uint32_t start, const uint32_t end)
+        {
+            auto& program = mThreadPrograms[mThreadIdMap.at(std::this_thread::get_id())];
+            program->vertexShader->gl_InstanceID = mInstanceID;
+            program->vertexShader->gl_InstanceData = mInstanceData;
+
+            for (uint32_t n = start; n < end; n++)
+            {
+                const uint32_t i = mShadeList[n];
+
+                // attributes are read straight from the mesh
+                program->bindVertexAttributes(const_cast<Vertex*>(ctx.vertices + i));
+                program->bindVertexShaderVaryings(ctx.getVaryings(i));
+                program->executeVertexShader();
+
+                // fused clip mask, perspective divide and viewport transform
+                ctx.clipPositions[i] = program->vertexShader->gl_Position;
+                ctx.clipMasks[i] = calculateFrustumClipMask(ctx.clipPositions[i], guardBand);
+                clipToScreen(i);
+            }
+        });
+
+        mThreadPool.wait_for_tasks();
     }
 
     //Clipping in the homogeneous clipping space
@@ -566,23 +921,9 @@ namespace SoftRenderer
             return;
         }
 
-        auto& vertexBuffer = mRenderContex.vertexBuffer;
+        auto& ctx          = mRenderContex;
         auto& faceBuffer   = mRenderContex.faceBuffer;
 
-        auto calculateFrustumClipMask = [](glm::vec4 &clip_pos, float near, float far) -> uint32_t
-        {
-            uint32_t mask = 0;
-            if (clip_pos.w < clip_pos.x) mask |= FrustumClipMask::POSITIVE_X;
-            if (clip_pos.w < -clip_pos.x) mask |= FrustumClipMask::NEGATIVE_X;
-            if (clip_pos.w < clip_pos.y) mask |= FrustumClipMask::POSITIVE_Y;
-            if (clip_pos.w < -clip_pos.y) mask |= FrustumClipMask::NEGATIVE_Y;
-            if (clip_pos.w < clip_pos.z) mask |= FrustumClipMask::POSITIVE_Z;
-            if (clip_pos.w < -clip_pos.z) mask |= FrustumClipMask::NEGATIVE_Z;
-            //if (clip_pos.w > far) mask |= FrustumClipMask::FAR;
-            //if (clip_pos.w < near) mask |= FrustumClipMask::NEAR;
-            return mask;
-        };
-
         const glm::vec4 frustumClipPlane[6] = 
         {
             {-1, 0, 0, 1},
@@ -601,15 +942,17 @@ namespace SoftRenderer
             int32_t idx1 = face.indices[1];
             int32_t idx2 = face.indices[2];
 
-            auto vertex0 = vertexBuffer[idx0];
-            auto vertex1 = vertexBuffer[idx1];
-            auto vertex2 = vertexBuffer[idx2];
+            uint32_t clipMask = ctx.clipMasks[idx0] | ctx.clipMasks[idx1] | ctx.clipMasks[idx2];
 
-            const uint32_t clipMask0 = calculateFrustumClipMask(vertex0.position, mDepthRange.n, mDepthRange.f);
-            const uint32_t clipMask1 = calculateFrustumClipMask(vertex1.position, mDepthRange.n, mDepthRange.f);
-            const uint32_t clipMask2 = calculateFrustumClipMask(vertex2.position, mDepthRange.n, mDepthRange.f);
+            // if the triangle is completely outside one of the clip planes
+            if (ctx.clipMasks[idx0] & ctx.clipMasks[idx1] & ctx.clipMasks[idx2] & frustumClipMaskPlanes)
+            {
+                face.discard = true;
+                continue;
+            }
 
-            uint32_t clipMask = clipMask0 | clipMask1 | clipMask2;
+            // inside the guard band only near/far are clipped, the rasterizer scissors x/y to the viewport
+            clipMask &= (clipMask & FrustumClipMask::GUARD_BAND) ? frustumClipMaskPlanes : frustumClipMaskZ;
 
             // if the triangle is completely inside the clip plane
             if (clipMask == 0) 
@@ -617,25 +960,30 @@ namespace SoftRenderer
                 continue;
             }
 
+            // a triangle clipped by 6 planes has at most 9 vertices
             bool isfullClip = false;
-            std::vector<int32_t> indicesIn;
-            std::vector<int32_t> indicesOut;
+            int32_t polygonA[9];
+            int32_t polygonB[9];
+            int32_t* indicesIn = polygonA;
+            int32_t* indicesOut = polygonB;
+            size_t indicesInCount = 3;
+            size_t indicesOutCount = 0;
 
-            indicesIn.push_back(idx0);
-            indicesIn.push_back(idx1);
-            indicesIn.push_back(idx2);
+            indicesIn[0] = idx0;
+            indicesIn[1] = idx1;
+            indicesIn[2] = idx2;
 
             for (uint32_t clipPlaneIndex = 0; clipPlaneIndex < 6; clipPlaneIndex++) 
             {
                 if (clipMask & frustumClipMaskArray[clipPlaneIndex]) 
                 {
-                    if (indicesIn.size() < 3) 
+                    if (indicesInCount < 3) 
                     {
                         isfullClip = true;
                         break;
                     }
 
-                    indicesOut.clear();
+                    indicesOutCount = 0;
 
                 // int idx_pre = indicesIn[0];
                 // float d_pre = glm::dot(frustumClipPlane[clipPlaneIndex], vertexBuffer[idx_pre].position);
@@ -666,19 +1014,19 @@ namespace SoftRenderer
                 // }
 
 
-                    const size_t numIndices = indicesIn.size();
+                    const size_t numIndices = indicesInCount;
                     for(size_t i = 0; i < numIndices; i++)
                     {
                         const int32_t index1 = indicesIn[i];
                         const int32_t index2 = indicesIn[(i+1) < numIndices  ? i+1 : 0];
                         
-                        const float d1 = glm::dot(frustumClipPlane[clipPlaneIndex], vertexBuffer[index1].position);
-                        const float d2 = glm::dot(frustumClipPlane[clipPlaneIndex], vertexBuffer[index2].position);
+                        const float d1 = glm::dot(frustumClipPlane[clipPlaneIndex], glm::vec4(ctx.clipPositions[index1]));
+                        const float d2 = glm::dot(frustumClipPlane[clipPlaneIndex], glm::vec4(ctx.clipPositions[index2]));
 
                         // if current vertex is inside
                         if(d1 >= 0)
                         {
-                            indicesOut.push_back(index1);
+                            indicesOut[indicesOutCount++] = index1;
                         }
 
                         // if one vertex is inside and another one is outside
@@ -686,18 +1034,18 @@ namespace SoftRenderer
                         {
                             float t = d2 < 0 ? d1 / (d1 - d2) : -d1 / (d2 - d1);
 
-                            auto newVertex = mRenderContex.VertexHolderInterpolate(&vertexBuffer[index1], &vertexBuffer[index2], t);
-
-                            vertexBuffer.push_back(newVertex);
+                            const int32_t newIndex = ctx.VertexHolderInterpolate(index1, index2, t);
+                            clipToScreen(newIndex);
 
-                            indicesOut.push_back((int) (vertexBuffer.size() - 1));
+                            indicesOut[indicesOutCount++] = newIndex;
                         }
                     }
                     std::swap(indicesIn, indicesOut);
+                    indicesInCount = indicesOutCount;
                 }
             }
 
-            if (isfullClip || indicesIn.empty())  
+            if (isfullClip || indicesInCount < 3)  
             {
                 face.discard = true;
                 continue;
@@ -708,7 +1056,7 @@ namespace SoftRenderer
             face.indices[2] = indicesIn[2];
 
             // create new face
-            for (size_t i = 3; i < indicesIn.size(); i++) 
+            for (size_t i = 3; i < indicesInCount; i++) 
             {
                 FaceResource newFace;
                 newFace.indices[0] = indicesIn[0];
@@ -720,22 +1068,6 @@ namespace SoftRenderer
         }
     }
 
-    void Graphics::processPerspectiveDivide()
-    {
-        for (auto& vertex : mRenderContex.vertexBuffer)
-        {
-            perspectiveDivide1(vertex.position);
-        }
-    }
-
-    void Graphics::processViewportTransform()
-    {
-        for (auto& vertex : mRenderContex.vertexBuffer)
-        {
-            viewportTransform1(vertex.position);
-        }
-    }
-
     void Graphics::processBackFaceCulling()
     {
         for (auto& face : mRenderContex.faceBuffer)
@@ -745,9 +1077,9 @@ namespace SoftRenderer
                 continue;
             }
 
-            glm::vec4 v0 = mRenderContex.vertexBuffer[face.indices[0]].position;
-            glm::vec4 v1 = mRenderContex.vertexBuffer[face.indices[1]].position;
-            glm::vec4 v2 = mRenderContex.vertexBuffer[face.indices[2]].position;
+            glm::vec4 v0 = mRenderContex.positions[face.indices[0]];
+            glm::vec4 v1 = mRenderContex.positions[face.indices[1]];
+            glm::vec4 v2 = mRenderContex.positions[face.indices[2]];
 
             glm::vec3 n = glm::cross(glm::vec3(v1 - v0), glm::vec3(v2- v0));
             float d = glm::dot(n, glm::vec3(0, 0, 1));
@@ -764,20 +1096,168 @@ namespace SoftRenderer
 
     void Graphics::processRasterization()
     {
-        for(auto& quad : mFragmentQuad)
+        updateThreadPrograms();
+
+        const uint32_t varyingsAlignedSize = RenderContex::calculateVaryingsAlignedSize(mRenderContex.varyingsCount);
+        for (size_t i = 0; i < mFragmentQuad.size(); i++)
         {
-            quad.allocateVaryings(mProgram->getShaderVaryingsSize());
-            quad.program = mProgram->clone();
+            auto& quad = mFragmentQuad[i];
+            quad.setVaryingsBuffer(mFrameArena.allocate<float>(4 * varyingsAlignedSize / sizeof(float)), varyingsAlignedSize);
+            quad.program = mThreadPrograms[i];
         }
-        
-        for (auto& face : mRenderContex.faceBuffer) 
+
+        // the shading pass of a depth pre-pass shades exactly the surfaces that won the depth-only pass
+        mRasterDepthFunc = mDepthPrepass == DepthPrepass::PREPASS_SHADING ? DepthFunc::DEPTH_EQUAL : mDepthFunc;
+        mRasterDepthMask = mDepthPrepass == DepthPrepass::PREPASS_SHADING ? false : mEnableDepthMask;
+
+        processTileBinning();
+
+        // sort-middle: every tile is rasterized and shaded by one thread in submission order,
+        // so depth and color writes need no synchronization
+        for (int32_t tileY = 0; tileY < mTileCountY; tileY++)
         {
-            if (face.discard) 
+            for (int32_t tileX = 0; tileX < mTileCountX; tileX++)
+            {
+                const uint32_t tileIndex = tileY * mTileCountX + tileX;
+                if (mTileBinOffsets[tileIndex] == mTileBinOffsets[tileIndex + 1])
+                {
+                    continue;
+                }
+
+                mThreadPool.push_task([this, tileX, tileY, tileIndex]
+                {
+                    auto& fragementQuad = mFragmentQuad[mThreadIdMap.at(std::this_thread::get_id())];
+
+                    const glm::ivec4 tileRect(tileX * SOFTGL_TILE_SIZE, tileY * SOFTGL_TILE_SIZE,
+                                              std::min((tileX + 1) * SOFTGL_TILE_SIZE, mWidth) - 1,
+                                              std::min((tileY + 1) * SOFTGL_TILE_SIZE, mHeight) - 1);
+
+                    for (uint32_t i = mTileBinOffsets[tileIndex]; i < mTileBinOffsets[tileIndex + 1]; i++)
+                    {
+                        rasterizeTriangle4(mRenderContex.faceBuffer[mTileBinFaces[i]], fragementQuad, tileRect);
+                    }
+
+                    // depth writes only widen the Hi-Z bounds, tighten the tiles they touched once per task
+                    for (int32_t hiZTileY = tileRect.y / SOFTGL_HIZ_TILE_SIZE; hiZTileY <= tileRect.w / SOFTGL_HIZ_TILE_SIZE; hiZTileY++)
+                    {
+                        for (int32_t hiZTileX = tileRect.x / SOFTGL_HIZ_TILE_SIZE; hiZTileX <= tileRect.z / SOFTGL_HIZ_TILE_SIZE; hiZTileX++)
+                        {
+                            mBackBuffer->updateHiZ(hiZTileX, hiZTileY);
+                        }
+                    }
+                });
+            }
+        }
+
+        mThreadPool.wait_for_tasks();
+    }
+
+    // screen position snapped to SOFTGL_SUBPIXEL_BITS fixed point, binning and rasterization share it
+    static glm::ivec2 snapToSubpixel(const glm::vec4& position)
+    {
+        const float subpixelScale = (float)(1 << SOFTGL_SUBPIXEL_BITS);
+        return glm::ivec2((int32_t)std::floor(position.x * subpixelScale + 0.5f), (int32_t)std::floor(position.y * subpixelScale + 0.5f));
+    }
+
+    void Graphics::processTileBinning()
+    {
+        const uint32_t tileCount = mTileCountX * mTileCountY;
+        const auto& faceBuffer = mRenderContex.faceBuffer;
+
+        // tile range of every face, x = -1 for faces that are not binned
+        glm::ivec4* faceTiles = mFrameArena.allocate<glm::ivec4>(faceBuffer.size());
+        uint32_t* binCounts = mFrameArena.allocate<uint32_t>(tileCount);
+        std::fill(binCounts, binCounts + tileCount, 0);
+
+        for (uint32_t faceIndex = 0; faceIndex < faceBuffer.size(); faceIndex++)
+        {
+            const auto& face = faceBuffer[faceIndex];
+            faceTiles[faceIndex].x = -1;
+
+            if (face.discard)
             {
                 continue;
             }
-            rasterizeTriangle4(face);
+
+            const glm::ivec2 P0 = snapToSubpixel(mRenderContex.positions[face.indices[0]]);
+            const glm::ivec2 P1 = snapToSubpixel(mRenderContex.positions[face.indices[1]]);
+            const glm::ivec2 P2 = snapToSubpixel(mRenderContex.positions[face.indices[2]]);
+
+            // same snapped bounds as the rasterizer, so the bins cover exactly the scanned pixels
+            int32_t minX = std::max(std::min(P0.x, std::min(P1.x, P2.x)) >> SOFTGL_SUBPIXEL_BITS, 0);
+            int32_t minY = std::max(std::min(P0.y, std::min(P1.y, P2.y)) >> SOFTGL_SUBPIXEL_BITS, 0);
+            int32_t maxX = std::min(std::max(P0.x, std::max(P1.x, P2.x)) >> SOFTGL_SUBPIXEL_BITS, mWidth - 1);
+            int32_t maxY = std::min(std::max(P0.y, std::max(P1.y, P2.y)) >> SOFTGL_SUBPIXEL_BITS, mHeight - 1);
+
+            if (minX > maxX || minY > maxY)
+            {
+                continue;
+            }
+
+            const glm::ivec4 tiles(minX / SOFTGL_TILE_SIZE, minY / SOFTGL_TILE_SIZE, maxX / SOFTGL_TILE_SIZE, maxY / SOFTGL_TILE_SIZE);
+            faceTiles[faceIndex] = tiles;
+
+            for (int32_t tileY = tiles.y; tileY <= tiles.w; tileY++)
+            {
+                for (int32_t tileX = tiles.x; tileX <= tiles.z; tileX++)
+                {
+                    binCounts[tileY * mTileCountX + tileX]++;
+                }
+            }
+        }
+
+        mTileBinOffsets = mFrameArena.allocate<uint32_t>(tileCount + 1);
+        mTileBinOffsets[0] = 0;
+        for (uint32_t i = 0; i < tileCount; i++)
+        {
+            mTileBinOffsets[i + 1] = mTileBinOffsets[i] + binCounts[i];
+            binCounts[i] = mTileBinOffsets[i];  // reused as write cursor
         }
+
+        mTileBinFaces = mFrameArena.allocate<uint32_t>(std::max(mTileBinOffsets[tileCount], 1u));
+        for (uint32_t faceIndex = 0; faceIndex < faceBuffer.size(); faceIndex++)
+        {
+            const glm::ivec4& tiles = faceTiles[faceIndex];
+            if (tiles.x < 0)
+            {
+                continue;
+            }
+
+            for (int32_t tileY = tiles.y; tileY <= tiles.w; tileY++)
+            {
+                for (int32_t tileX = tiles.x; tileX <= tiles.z; tileX++)
+                {
+                    mTileBinFaces[binCounts[tileY * mTileCountX + tileX]++] = faceIndex;
+                }
+            }
+        }
+    }
+
+    // the box is outside when all of its corners are outside the same clip plane
+    bool Graphics::isBoundsCulled(const BoxSphereBounds& bounds, const glm::mat4& modelViewProject) const
+    {
+        uint32_t mask = frustumClipMaskPlanes;
+        for (int32_t i = 0; i < 8 && mask != 0; i++)
+        {
+            const glm::vec3 corner = bounds.mOrigin + bounds.mBoxExtent * glm::vec3(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f);
+            mask &= calculateFrustumClipMask(modelViewProject * glm::vec4(corner, 1.0f), glm::vec2(1.0f));
+        }
+
+        return mask != 0;
+    }
+
+    void Graphics::updateThreadPrograms()
+    {
+        if (mThreadProgramsSource == mProgram)
+        {
+            return;
+        }
+
+        for (auto& program : mThreadPrograms)
+        {
+            program = mProgram->clone();
+        }
+        mThreadProgramsSource = mProgram;
     }
 
      void Graphics::ProcessFaceWireframe()
@@ -797,10 +1277,7 @@ namespace SoftRenderer
                 int32_t idx0 = face.indices[i];
                 int32_t idx1 = face.indices[(i + 1) % 3];
 
-                auto &v0 = mRenderContex.vertexBuffer[idx0];
-                auto &v1 = mRenderContex.vertexBuffer[idx1];
-
-                drawLine(v0.position, v1.position, glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
+                drawLine(mRenderContex.positions[idx0], mRenderContex.positions[idx1], glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
             }
         }
      }
@@ -872,263 +1349,338 @@ namespace SoftRenderer
         }
     }
 
-    bool isSamplingInside(int32_t x, int32_t y, int32_t Cx1, int32_t Cx2, int32_t Cx3, int32_t boundingMaxX, int32_t boundingMaxY)
+    // 4x MSAA sample positions relative to the pixel center in subpixel units, the usual rotated grid
+    static const int32_t SAMPLE_OFFSETS[SOFTGL_MAX_SAMPLES][2] = { { -32, -96 }, { 96, -32 }, { -96, 32 }, { 32, 96 } };
+
+    void Graphics::rasterizeTriangle4(FaceResource& face, FragmentQuad& fragementQuad, const glm::ivec4& tileRect)
     {
-        //Invalid fragment
-        if (x > boundingMaxX || y > boundingMaxY)
+        glm::aligned_vec4 screenPosition[3];
+        for (int32_t i = 0; i < 3; i++) 
         {
-            return false;
+            screenPosition[i] = mRenderContex.positions[face.indices[i]];
         }
 
-        bool atLeastOneInside = false;
-
+        // snap to fixed point, coverage is decided exactly at pixel centers
+        glm::ivec2 P[3];
+        for (int32_t i = 0; i < 3; i++)
         {
-            //Edge function
-            const float E1 = Cx1;
-            const float E2 = Cx2;
-            const float E3 = Cx3;
-
-            //Note: Counter-clockwise winding order
-            if (E1  >= 0 && E2 >= 0 && E3 >= 0)
-            {
-                atLeastOneInside = true;
-                //Note: each sampling point should have its own depth
-                //glm::vec3 uvw = glm::vec3(E2, E3, E1) * one_div_delta;
-            }
-        }
-
-        return atLeastOneInside;
-    }
-
-    bool Barycentric(glm::aligned_vec4* vert, glm::aligned_vec4& v0, glm::aligned_vec4& p, glm::aligned_vec4& bc)
-    {
-        glm::vec3 u = glm::cross(glm::vec3(vert[0]) - glm::vec3(v0.x, v0.x, p.x + 0.5f), glm::vec3(vert[1]) - glm::vec3(v0.y, v0.y, p.y + 0.5f));
-        if (std::abs(u.z) < 1.192092896e-07F) {
-            return false;
+            P[i] = snapToSubpixel(screenPosition[i]);
         }
 
-        u /= u.z;
-        bc = { 1.f - (u.x + u.y), u.y, u.x, 0.f };
+        int32_t minX = std::max(std::min(P[0].x, std::min(P[1].x, P[2].x)) >> SOFTGL_SUBPIXEL_BITS, 0);
+        int32_t minY = std::max(std::min(P[0].y, std::min(P[1].y, P[2].y)) >> SOFTGL_SUBPIXEL_BITS, 0);
+        int32_t maxX = std::min(std::max(P[0].x, std::max(P[1].x, P[2].x)) >> SOFTGL_SUBPIXEL_BITS, mWidth - 1);
+        int32_t maxY = std::min(std::max(P[0].y, std::max(P[1].y, P[2].y)) >> SOFTGL_SUBPIXEL_BITS, mHeight - 1);
 
-        if (bc.x < 0 || bc.y < 0 || bc.z < 0) {
-            return false;
-        }
+        // clamp to the tile, quads start on even pixels so they never straddle two tiles
+        const int32_t startX = std::max(minX, tileRect.x) & ~1;
+        const int32_t startY = std::max(minY, tileRect.y) & ~1;
+        const int32_t endX = std::min(maxX, tileRect.z);
+        const int32_t endY = std::min(maxY, tileRect.w);
 
-        return true;
-    }
+        if (startX > endX || startY > endY)
+            return;
 
-    void Graphics::rasterizeTriangle4(FaceResource& face)
-    {
-        glm::aligned_vec4 screenPosition[3];
-        for (int32_t i = 0; i < 3; i++) 
+        // edge e runs from P[e] to P[e + 1]: E(p) = I * px + J * py + K in subpixel units, positive inside
+        //I = Ay - By, J = Bx - Ax, K = AxBy - AyBx
+        int32_t I[3];
+        int32_t J[3];
+        int64_t K[3];
+        for (int32_t e = 0; e < 3; e++)
         {
-            auto& vertex = mRenderContex.vertexBuffer[face.indices[i]];
-            screenPosition[i] = vertex.position;
+            const glm::ivec2& a = P[e];
+            const glm::ivec2& b = P[(e + 1) % 3];
+            I[e] = a.y - b.y;
+            J[e] = b.x - a.x;
+            K[e] = (int64_t)a.x * b.y - (int64_t)a.y * b.x;
         }
 
-        const glm::ivec2& A = glm::ivec2((int32_t)(screenPosition[0].x), (int32_t)(screenPosition[0].y));
-        const glm::ivec2& B = glm::ivec2((int32_t)(screenPosition[1].x), (int32_t)(screenPosition[1].y));
-        const glm::ivec2& C = glm::ivec2((int32_t)(screenPosition[2].x), (int32_t)(screenPosition[2].y));
+        // twice the area in subpixel units
+        const int64_t area = K[0] + K[1] + K[2];
 
-        int32_t minX = std::max(std::min(A.x, std::min(B.x, C.x)), 0);
-        int32_t minY = std::max(std::min(A.y, std::min(B.y, C.y)), 0);
-        int32_t maxX = std::min(std::max(A.x, std::max(B.x, C.x)), mWidth );
-        int32_t maxY = std::min(std::max(A.y, std::max(B.y, C.y)), mHeight );
+        //Degenerated to a line or a point
+        if (area == 0)
+            return;
 
-        //I1 = Ay - By, I2 = By - Cy, I3 = Cy - Ay
-        int32_t I01 = A.y - B.y;
-        int32_t I02 = B.y - C.y;
-        int32_t I03 = C.y - A.y;
+        // either winding, weights are normalized so the sign cancels
+        if (area < 0)
+        {
+            for (int32_t e = 0; e < 3; e++)
+            {
+                I[e] = -I[e];
+                J[e] = -J[e];
+                K[e] = -K[e];
+            }
+        }
 
-        //J1 = Bx - Ax, J2 = Cx - Bx, J3 = Ax - Cx 
-        int32_t J01 = B.x - A.x;
-        int32_t J02 = C.x - B.x;
-        int32_t J03 = A.x - C.x;
+        // at the pixel center (x + 0.5, y + 0.5) E = 2^bits * (I * x + J * y) + K + (I + J) * 2^(bits - 1), so
+        // E + bias >= 0 exactly when I * x + J * y + floor((K + (I + J) * 2^(bits - 1) + bias) / 2^bits) >= 0.
+        // Top-left rule: centers on an edge belong to the triangle that has it as a left or top edge, bias -1 turns >= into > for the others.
+        // Multisampling tests the same way at each sample position. Blocks are rejected by the sample furthest inside each edge
+        // and accepted by the one furthest outside, K stays the center for the attribute weights.
+        int64_t sampleK[SOFTGL_MAX_SAMPLES][3];
+        glm::vec3 sampleEdgeOffsets[SOFTGL_MAX_SAMPLES];
+        int64_t rejectK[3];
+        int64_t acceptK[3];
+        for (int32_t e = 0; e < 3; e++)
+        {
+            const bool topLeft = I[e] > 0 || (I[e] == 0 && J[e] < 0);
+            const int64_t centerK = K[e] + (int64_t)(I[e] + J[e]) * (1 << (SOFTGL_SUBPIXEL_BITS - 1)) - (topLeft ? 0 : 1);
+            K[e] = centerK >> SOFTGL_SUBPIXEL_BITS;
+            rejectK[e] = K[e];
+            acceptK[e] = K[e];
 
-        //K1 = AxBy - AyBx, K2 = BxCy - ByCx, K3 = CxAy - CyAx
-        int32_t K01 = A.x * B.y - A.y * B.x;
-        int32_t K02 = B.x * C.y - B.y * C.x;
-        int32_t K03 = C.x * A.y - C.y * A.x;
+            if (mSampleCount > 1)
+            {
+                for (int32_t s = 0; s < SOFTGL_MAX_SAMPLES; s++)
+                {
+                    sampleK[s][e] = (centerK + (int64_t)I[e] * SAMPLE_OFFSETS[s][0] + (int64_t)J[e] * SAMPLE_OFFSETS[s][1]) >> SOFTGL_SUBPIXEL_BITS;
+                    rejectK[e] = s == 0 ? sampleK[s][e] : std::max(rejectK[e], sampleK[s][e]);
+                    acceptK[e] = s == 0 ? sampleK[s][e] : std::min(acceptK[e], sampleK[s][e]);
+                }
+            }
+        }
 
-        //F1 = I1 * Px + J1 * Py + K1
-        //F2 = I2 * Px + J2 * Py + K2
-        //F3 = I3 * Px + J3 * Py + k3
-        int32_t F01 = (I01 * minX) + (J01 * minY) + K01;
-        int32_t F02 = (I02 * minX) + (J02 * minY) + K02;
-        int32_t F03 = (I03 * minX) + (J03 * minY) + K03;
+        // in the vertex order of the attribute weights
+        for (int32_t s = 0; s < SOFTGL_MAX_SAMPLES; s++)
+        {
+            const float subpixelStep = 1.0f / (1 << SOFTGL_SUBPIXEL_BITS);
+            sampleEdgeOffsets[s] = glm::vec3(I[1] * SAMPLE_OFFSETS[s][0] + J[1] * SAMPLE_OFFSETS[s][1],
+                                             I[2] * SAMPLE_OFFSETS[s][0] + J[2] * SAMPLE_OFFSETS[s][1],
+                                             I[0] * SAMPLE_OFFSETS[s][0] + J[0] * SAMPLE_OFFSETS[s][1]) * subpixelStep;
+        }
 
-        // Area = 1/2 * |AB| * |AC| * sin(|AB|, |AC|) = 1/2 * (AxBy - AyBx + BxCy - ByCx + CxAy - CyAx) = F1 + F2 + F3
-        int32_t delta = F01 + F02 + F03;
+        fragementQuad.front_facing = face.frontFacing;
 
-        //Degenerated to a line or a point
-        if (delta == 0)
-            return;
+        // triangle setup, per pixel only the edge functions are stepped and one reciprocal normalizes the weights
+        for (int32_t i = 0; i < 3; i++)
+        {
+            const glm::aligned_vec4& position = mRenderContex.positions[face.indices[i]];
+            fragementQuad.triangularVertexScreenPosition[i] = position;
+            fragementQuad.triangularVertexVarings[i] = mRenderContex.getVaryings(face.indices[i]);
+            fragementQuad.triangularVertexOneDivideClipZ[i] = 1.0f / ((mDepthRange.f + mDepthRange.n - position.z) * position.w);  // [far, near] -> [near, far]
+            fragementQuad.triangularVertexDepth[i] = position.z;
+            fragementQuad.triangularVertexW[i] = position.w;
+        }
 
-        const float oneDivideDelta = 1 / (float)delta;
+        EdgeCoverage::Setup coverageSetup;
+        EdgeCoverage::setup(coverageSetup, I, J);
 
-        int32_t Cy1 = F01, Cy2 = F02, Cy3 = F03;
+        // depth range of the triangle for Hi-Z, fragment depth is a convex combination of the vertex depths
+        const float triangleMinDepth = std::min(screenPosition[0].z, std::min(screenPosition[1].z, screenPosition[2].z));
+        const float triangleMaxDepth = std::max(screenPosition[0].z, std::max(screenPosition[1].z, screenPosition[2].z));
+        const bool enableHiZ = mEnableDepthTest && fragementQuad.program->fragmentShader->getFragDepthLayout() == FragDepthLayout::DEPTH_UNCHANGED;
+        const bool earlyDepthTest = enableHiZ && !fragementQuad.program->fragmentShader->usesDiscard();
+        const bool depthOnly = mDepthPrepass == DepthPrepass::PREPASS_DEPTH_ONLY;
 
-        auto block_size = (float)32;
-        int32_t blockCountX = (int32_t)((maxX - minX + block_size - 1.0f) / block_size);
-        int32_t blockCountY = (int32_t)((maxY - minY + block_size - 1.0f) / block_size);
+        // hierarchical traversal: blocks outside an edge are skipped, blocks inside every edge skip the coverage test
+        const int32_t blockStartX = startX & ~(SOFTGL_BLOCK_SIZE - 1);
+        const int32_t blockStartY = startY & ~(SOFTGL_BLOCK_SIZE - 1);
 
-        auto thread_id_map = mThreadPool.get_thread_id_map();
-        for (int32_t blockY = 0; blockY < blockCountY; blockY++)
+        for (int32_t blockY = blockStartY; blockY <= endY; blockY += SOFTGL_BLOCK_SIZE)
         {
-            for (int32_t blockX = 0; blockX < blockCountX; blockX++)
+            for (int32_t blockX = blockStartX; blockX <= endX; blockX += SOFTGL_BLOCK_SIZE)
             {
-                mThreadPool.push_task([&, block_size, blockX, blockY]
+                const int32_t blockMaxX = blockX + SOFTGL_BLOCK_SIZE - 1;
+                const int32_t blockMaxY = blockY + SOFTGL_BLOCK_SIZE - 1;
+
+                // edge functions are linear, so their extremes over the block are at its corners.
+                // 64 bit, large viewports overflow 32 bits once positions carry subpixel bits
+                bool rejected = false;
+                bool accepted = blockMaxX <= maxX && blockMaxY <= maxY;
+                int64_t blockEdge[3];
+                for (int32_t e = 0; e < 3; e++)
                 {
-                    //TODO too slow here
-                    //FragmentQuad fragementQuad(mRenderContex.varyingsAlignedSize);
-                    //fragementQuad.program = mProgram->clone();
-
-
-                    auto& fragementQuad = mFragmentQuad[thread_id_map[std::this_thread::get_id()]];
+                    const int64_t c0 = (int64_t)I[e] * blockX + (int64_t)J[e] * blockY;
+                    const int64_t c1 = c0 + (int64_t)I[e] * (SOFTGL_BLOCK_SIZE - 1);
+                    const int64_t c2 = c0 + (int64_t)J[e] * (SOFTGL_BLOCK_SIZE - 1);
+                    const int64_t c3 = c1 + (int64_t)J[e] * (SOFTGL_BLOCK_SIZE - 1);
+                    blockEdge[e] = c0;
 
-                    fragementQuad.front_facing = face.frontFacing;
+                    if (std::max(std::max(c0, c1), std::max(c2, c3)) + rejectK[e] < 0)
+                    {
+                        rejected = true;
+                        break;
+                    }
 
-                    for (int32_t i = 0; i < 3; i++)
+                    if (std::min(std::min(c0, c1), std::min(c2, c3)) + acceptK[e] < 0)
                     {
-                        auto& vertex = mRenderContex.vertexBuffer[face.indices[i]];
-                        fragementQuad.triangularVertexScreenPosition[i] = vertex.position;
-                        fragementQuad.triangularVertexVarings[i] = vertex.varyings;
-                        fragementQuad.triangularVertexClipZ[i] = (mDepthRange.f + mDepthRange.n - vertex.position.z) * vertex.position.w;  // [far, near] -> [near, far]
+                        accepted = false;
                     }
+                }
+
+                if (rejected)
+                {
+                    continue;
+                }
 
-                    const glm::aligned_vec4* triangularVertexScreenPosition = fragementQuad.triangularVertexScreenPosition;
-                    fragementQuad.triangularVertexScreenPositionFlat[0] = { triangularVertexScreenPosition[2].x, triangularVertexScreenPosition[1].x, triangularVertexScreenPosition[0].x, 0.f };
-                    fragementQuad.triangularVertexScreenPositionFlat[1] = { triangularVertexScreenPosition[2].y, triangularVertexScreenPosition[1].y, triangularVertexScreenPosition[0].y, 0.f };
-                    fragementQuad.triangularVertexScreenPositionFlat[2] = { triangularVertexScreenPosition[0].z, triangularVertexScreenPosition[1].z, triangularVertexScreenPosition[2].z, 0.f };
-                    fragementQuad.triangularVertexScreenPositionFlat[3] = { triangularVertexScreenPosition[0].w, triangularVertexScreenPosition[1].w, triangularVertexScreenPosition[2].w, 0.f };
+                const uint32_t hiZTileX = blockX / SOFTGL_HIZ_TILE_SIZE;
+                const uint32_t hiZTileY = blockY / SOFTGL_HIZ_TILE_SIZE;
 
-                    int32_t Dy1 = Cy1 + block_size * blockY * J01;
-                    int32_t Dy2 = Cy2 + block_size * blockY * J02;
-                    int32_t Dy3 = Cy3 + block_size * blockY * J03;
+                if (enableHiZ && hiZOccluded(hiZTileX, hiZTileY, triangleMinDepth, triangleMaxDepth))
+                {
+                    continue;
+                }
 
-                    // block rasterization
-                    int32_t blockStartX = (int32_t)(minX + blockX * block_size);
-                    int32_t blockStartY = (int32_t)(minY + blockY * block_size);
+                const int32_t quadStartX = std::max(blockX, startX);
+                const int32_t quadStartY = std::max(blockY, startY);
+                const int32_t quadEndX = std::min(blockMaxX, endX);
+                const int32_t quadEndY = std::min(blockMaxY, endY);
 
-                    for (int32_t y = blockStartY; y < blockStartY + block_size && y <= maxY; y += 2)
+                for (int32_t y = quadStartY; y <= quadEndY; y += 2)
+                {
+                    for (int32_t x = quadStartX; x <= quadEndX; x += 4)
                     {
-                        int32_t Dx1 = Dy1 + block_size * blockX * I01;
-                        int32_t Dx2 = Dy2 + block_size * blockX * I02;
-                        int32_t Dx3 = Dy3 + block_size * blockX * I03;
+                        // the coverage kernels are 32 bit, clamping keeps the sign of every lane since lane offsets stay below 2^26
+                        auto clampEdge = [](int64_t value) { return (int32_t)std::min(std::max(value, (int64_t)-(1 << 30)), (int64_t)(1 << 30)); };
 
-                        for (int32_t x = blockStartX; x < blockStartX + block_size && x <= maxX; x += 2)
+                        int64_t edge[3];
+                        int32_t Dx[3];
+                        for (int32_t e = 0; e < 3; e++)
+                        {
+                            edge[e] = blockEdge[e] + (int64_t)I[e] * (x - blockX) + (int64_t)J[e] * (y - blockY);
+                            Dx[e] = clampEdge(edge[e] + K[e]);
+                        }
+
+                        uint32_t coverage = 0;
+                        uint32_t sampleCoverage[SOFTGL_MAX_SAMPLES];
+                        if (mSampleCount > 1)
+                        {
+                            // a pixel is shaded once if any of its samples is covered
+                            for (int32_t s = 0; s < SOFTGL_MAX_SAMPLES; s++)
+                            {
+                                const int32_t sampleDx[3] = { clampEdge(edge[0] + sampleK[s][0]), clampEdge(edge[1] + sampleK[s][1]), clampEdge(edge[2] + sampleK[s][2]) };
+                                sampleCoverage[s] = accepted ? 0xFF : EdgeCoverage::coverage(coverageSetup, sampleDx, maxX - x, maxY - y);
+                                coverage |= sampleCoverage[s];
+                            }
+                        }
+                        else
                         {
-                            fragementQuad.init(x, y);
+                            coverage = accepted ? 0xFF : EdgeCoverage::coverage(coverageSetup, Dx, maxX - x, maxY - y);
+                        }
 
-                            bool inside0 = isSamplingInside(x, y, Dx1, Dx2, Dx3, maxX, maxY);
-                            bool inside1 = isSamplingInside(x + 1, y, Dx1 + I01, Dx2 + I02, Dx3 + I03, maxX, maxY);
-                            bool inside2 = isSamplingInside(x, y + 1, Dx1 + J01, Dx2 + J02, Dx3 + J03, maxX, maxY);
-                            bool inside3 = isSamplingInside(x + 1, y + 1, Dx1 + J01 + I01, Dx2 + J02 + I02, Dx3 + J03 + I03, maxX, maxY);
+                        // the second quad belongs to the next block
+                        if (x + 2 > quadEndX)
+                        {
+                            coverage &= 0xF;
+                        }
 
-                            if (inside0 || inside1 || inside2 || inside3)
+                        for (int32_t q = 0; q < 2; q++)
+                        {
+                            const uint32_t quadCoverage = (coverage >> (q * 4)) & 0xF;
+                            if (quadCoverage == 0)
                             {
+                                continue;
+                            }
 
-                                if (inside0)
-                                {
-                                    glm::vec3 uvw(Dx2, Dx3, Dx1);
-                                    glm::vec3 weights = uvw * oneDivideDelta;
-                                    fragementQuad.pixels[0].barycentric = glm::aligned_vec4(weights, 0.0f);
-                                    //glm::aligned_vec4* vert = fragementQuad.vert_flat;
-                                    //glm::aligned_vec4& v0 = fragementQuad.screen_pos[0];
-                                    //Barycentric(vert, v0, fragementQuad.pixels[0].position, fragementQuad.pixels[0].barycentric);
-                                    fragementQuad.pixels[0].inside = true;
-                                }
-                                else
-                                {
-                                    glm::aligned_vec4* vert = fragementQuad.triangularVertexScreenPositionFlat;
-                                    glm::aligned_vec4& v0 = fragementQuad.triangularVertexScreenPosition[0];
-                                    Barycentric(vert, v0, fragementQuad.pixels[0].position, fragementQuad.pixels[0].barycentric);
-                                    fragementQuad.pixels[0].inside = false;
-                                }
+                            fragementQuad.init(x + q * 2, y);
 
-                                if (inside1)
-                                {
-                                    glm::vec3 uvw(Dx2 + I02, Dx3 + I03, Dx1 + I01);
-                                    glm::vec3 weights = uvw * oneDivideDelta;
-                                    fragementQuad.pixels[1].barycentric = glm::aligned_vec4(weights, 0.0f);
-                                    //glm::aligned_vec4* vert = fragementQuad.vert_flat;
-                                    //glm::aligned_vec4& v0 = fragementQuad.screen_pos[0];
-                                    //Barycentric(vert, v0, fragementQuad.pixels[1].position, fragementQuad.pixels[1].barycentric);
-                                    fragementQuad.pixels[1].inside = true;
-                                }
-                                else
-                                {
-                                    glm::aligned_vec4* vert = fragementQuad.triangularVertexScreenPositionFlat;
-                                    glm::aligned_vec4& v0 = fragementQuad.triangularVertexScreenPosition[0];
-                                    Barycentric(vert, v0, fragementQuad.pixels[1].position, fragementQuad.pixels[1].barycentric);
-                                    fragementQuad.pixels[1].inside = false;
-                                }
+                            glm::vec3 quadEdges[4];
+                            for (int32_t i = 0; i < 4; i++)
+                            {
+                                auto& pixel = fragementQuad.pixels[i];
+                                pixel.inside = (quadCoverage >> i) & 1;
+                                pixel.sampleMask = pixel.inside;
 
-                                if (inside2)
-                                {
-                                    glm::vec3 uvw(Dx2 + J02, Dx3 + J03, Dx1 + J01);
-                                    glm::vec3 weights = uvw * oneDivideDelta;
-                                    fragementQuad.pixels[2].barycentric = glm::aligned_vec4(weights, 0.0f);
-                                    //glm::aligned_vec4* vert = fragementQuad.vert_flat;
-                                    //glm::aligned_vec4& v0 = fragementQuad.screen_pos[0];
-                                    //Barycentric(vert, v0, fragementQuad.pixels[2].position, fragementQuad.pixels[2].barycentric);
-                                    fragementQuad.pixels[2].inside = true;
-                                }
-                                else
+                                if (mSampleCount > 1)
                                 {
-                                    glm::aligned_vec4* vert = fragementQuad.triangularVertexScreenPositionFlat;
-                                    glm::aligned_vec4& v0 = fragementQuad.triangularVertexScreenPosition[0];
-                                    Barycentric(vert, v0, fragementQuad.pixels[2].position, fragementQuad.pixels[2].barycentric);
-                                    fragementQuad.pixels[2].inside = false;
+                                    pixel.sampleMask = 0;
+                                    for (int32_t s = 0; s < SOFTGL_MAX_SAMPLES; s++)
+                                    {
+                                        pixel.sampleMask |= ((sampleCoverage[s] >> (q * 4 + i)) & 1) << s;
+                                    }
                                 }
 
-                                if (inside3)
-                                {
-                                    glm::vec3 uvw(Dx2 + J02 + I02, Dx3 + J03 + I03, Dx1 + J01 + I01);
-                                    glm::vec3 weights = uvw * oneDivideDelta;
-                                    fragementQuad.pixels[3].barycentric = glm::aligned_vec4(weights, 0.0f);
-                                    //glm::aligned_vec4* vert = fragementQuad.vert_flat;
-                                    //glm::aligned_vec4& v0 = fragementQuad.screen_pos[0];
-                                    //Barycentric(vert, v0, fragementQuad.pixels[3].position, fragementQuad.pixels[3].barycentric);
-                                    fragementQuad.pixels[3].inside = true;
-                                }
-                                else
-                                {
-                                    glm::aligned_vec4* vert = fragementQuad.triangularVertexScreenPositionFlat;
-                                    glm::aligned_vec4& v0 = fragementQuad.triangularVertexScreenPosition[0];
-                                    Barycentric(vert, v0, fragementQuad.pixels[3].position, fragementQuad.pixels[3].barycentric);
-                                    fragementQuad.pixels[3].inside = false;
-                                }
+                                const int32_t dx = q * 2 + (i & 1);
+                                const int32_t dy = i >> 1;
+                                quadEdges[i] = glm::vec3((float)(edge[1] + K[1] + dx * I[1] + dy * J[1]), (float)(edge[2] + K[2] + dx * I[2] + dy * J[2]), (float)(edge[0] + K[0] + dx * I[0] + dy * J[0]));
+                            }
 
-                                // barycentric correction
-                                perspectiveCorrectInterpolation(fragementQuad);
+                            // barycentric correction
+                            perspectiveCorrectInterpolation(fragementQuad, quadEdges, mSampleCount > 1 ? sampleEdgeOffsets : nullptr);
 
-                                // varying interpolate
-                                // note: all quad pixels should perform varying interpolate to enable varying partial derivative
-                                for (auto& pixel : fragementQuad.pixels)
+                            // depth-only pass: no varyings, no shader, only the rasterized depth
+                            if (depthOnly)
+                            {
+                                earlyDepthTestQuad(fragementQuad);
+                                continue;
+                            }
+
+                            // early-z: hidden pixels skip varying interpolation and shading
+                            if (earlyDepthTest)
+                            {
+                                if (!earlyDepthTestQuad(fragementQuad))
                                 {
-                                    varyingInterpolate((float*)pixel.interpolatedVaryings, fragementQuad.triangularVertexVarings, mRenderContex.varyingsCount, pixel.barycentric);
+                                    continue;
                                 }
-
-                                // fragment quad shading
-                                pixelShading(fragementQuad);
                             }
 
-                            Dx1 += 2 * I01; Dx2 += 2 * I02; Dx3 += 2 * I03;
+                            // varying interpolate
+                            // note: all quad pixels should perform varying interpolate to enable varying partial derivative
+                            varyingInterpolateQuad(fragementQuad);
+
+                            // fragment quad shading
+                            pixelShading(fragementQuad, earlyDepthTest);
                         }
-                        Dy1 += 2 * J01;	Dy2 += 2 * J02; Dy3 += 2 * J03;
                     }
-                });
+                }
             }
         }
+    }
 
-        mThreadPool.wait_for_tasks();
+    bool Graphics::hiZOccluded(uint32_t tileX, uint32_t tileY, float minDepth, float maxDepth)
+    {
+        // occluded when no depth in the triangle range can pass against any depth stored in the tile
+        switch (mRasterDepthFunc)
+        {
+        case DepthFunc::DEPTH_EQUAL: return maxDepth < mBackBuffer->getHiZMin(tileX, tileY) || minDepth > mBackBuffer->getHiZMax(tileX, tileY);
+        case DepthFunc::DEPTH_GREATER: return maxDepth <= mBackBuffer->getHiZMin(tileX, tileY);
+        case DepthFunc::DEPTH_GEQUAL: return maxDepth < mBackBuffer->getHiZMin(tileX, tileY);
+        case DepthFunc::DEPTH_LESS: return minDepth >= mBackBuffer->getHiZMax(tileX, tileY);
+        case DepthFunc::DEPTH_LEQUAL: return minDepth > mBackBuffer->getHiZMax(tileX, tileY);
+        default: return false;
+        }
     }
 
-    void Graphics::pixelShading(FragmentQuad& fragementQuad)
+    bool Graphics::earlyDepthTestQuad(FragmentQuad& fragementQuad)
     {
+        bool passed = false;
+
         for (auto& pixel : fragementQuad.pixels)
         {
+            if (!pixel.inside)
+            {
+                continue;
+            }
+
+            // the shader keeps the rasterized depth, so testing and writing it now matches late-z
+            if (mSampleCount > 1)
+            {
+                pixel.sampleMask = depthTestSamples((uint32_t)pixel.position.x, (uint32_t)pixel.position.y, pixel.sampleDepth, pixel.sampleMask);
+                pixel.inside = pixel.sampleMask != 0;
+            }
+            else
+            {
+                pixel.inside = depthTest((uint32_t)pixel.position.x, (uint32_t)pixel.position.y, pixel.position.z);
+            }
+            passed |= pixel.inside;
+        }
+
+        return passed;
+    }
+
+    void Graphics::pixelShading(FragmentQuad& fragementQuad, bool depthTested)
+    {
+        void* varyings[4];
+        for (int32_t i = 0; i < 4; i++)
+        {
+            varyings[i] = fragementQuad.pixels[i].interpolatedVaryings;
+        }
+        fragementQuad.program->executeFragmentShaderQuad(varyings);
+
+        for (int32_t i = 0; i < 4; i++)
+        {
+            auto& pixel = fragementQuad.pixels[i];
             glm::aligned_vec4& pos = pixel.position;
             if (!pixel.inside)
             {
@@ -1147,16 +1699,47 @@ namespace SoftRenderer
 
             fragementQuad.program->fragmentShader->gl_FragDepth = pos.z;
 
+            fragementQuad.program->fragmentShader->discard = false;
+
+            fragementQuad.program->fragmentShader->gl_QuadPixelIndex = i;
+
             // pixel shading
             //fragementQuad.program->fragmentShader->shaderMain();
             fragementQuad.program->executeFragmentShader();
 
+            if (fragementQuad.program->fragmentShader->discard)
+            {
+                continue;
+            }
+
             // pixel color
             glm::vec4 color = glm::clamp(fragementQuad.program->fragmentShader->gl_FragColor, 0.0f, 1.0f);
 
+            if (depthTested)
+            {
+                mBackBuffer->writeColorSamples(x, y, color, pixel.sampleMask);
+                continue;
+            }
+
             // pixel depth
             float depth = fragementQuad.program->fragmentShader->gl_FragDepth;
 
+            if (mSampleCount > 1)
+            {
+                // a shader that writes its depth replaces the rasterized depth of every sample
+                if (depth != pos.z)
+                {
+                    std::fill(pixel.sampleDepth, pixel.sampleDepth + SOFTGL_MAX_SAMPLES, depth);
+                }
+
+                const uint32_t passed = depthTestSamples(x, y, pixel.sampleDepth, pixel.sampleMask);
+                if (passed)
+                {
+                    mBackBuffer->writeColorSamples(x, y, color, passed);
+                }
+                continue;
+            }
+
             if (depthTest(x, y, depth))
             {
                 mBackBuffer->writeColor(x, y, color);
@@ -1292,6 +1875,144 @@ namespace SoftRenderer
     {
         mDepthFunc = func;
     }
-}
 
+    void Graphics::setDepthPrepass(DepthPrepass prepass)
+    {
+        mDepthPrepass = prepass;
+    }
+
+    void Graphics::submit(const CommandBuffer& commandBuffer)
+    {
+        const CommandBuffer* commandBuffers[] = { &commandBuffer };
+        submit(commandBuffers, 1);
+    }
+
+    void Graphics::submit(const std::vector<const CommandBuffer*>& commandBuffers)
+    {
+        submit(commandBuffers.data(), commandBuffers.size());
+    }
+
+    void Graphics::submit(const CommandBuffer* const* commandBuffers, size_t commandBufferCount)
+    {
+        // replay the state commands once, every draw keeps a snapshot of the state it was recorded with.
+        // Draws before the first USE_PROGRAM point at a copy, the replay below reassigns mProgram
+        const std::shared_ptr<Program> initialProgram = mProgram;
+        DrawPacket state = {};
+        state.program = &initialProgram;
+        state.depthTest = mEnableDepthTest;
+        state.depthWrite = mEnableDepthMask;
+        state.depthFunc = mDepthFunc;
+        state.depthPrepass = mDepthPrepass;
+
+        mDrawPackets.clear();
+        for (size_t bufferIndex = 0; bufferIndex < commandBufferCount; bufferIndex++)
+        {
+            const CommandBuffer* commandBuffer = commandBuffers[bufferIndex];
+            const size_t firstPacket = mDrawPackets.size();
+            const auto& commands = commandBuffer->getCommands();
+
+            for (uint32_t i = 0; i < commands.size(); i++)
+            {
+                const auto& command = commands[i];
+                switch (command.type)
+                {
+                case CommandBuffer::CommandType::USE_PROGRAM:
+                    state.program = &commandBuffer->getProgram(command.value);
+                    state.uniforms = nullptr;
+                    break;
+                case CommandBuffer::CommandType::SET_UNIFORMS:
+                    state.uniforms = commandBuffer->getData(command.dataOffset);
+                    state.uniformsSize = command.dataSize;
+                    break;
+                case CommandBuffer::CommandType::SET_DEPTH_TEST:
+                    state.depthTest = command.value != 0;
+                    break;
+                case CommandBuffer::CommandType::SET_DEPTH_WRITE:
+                    state.depthWrite = command.value != 0;
+                    break;
+                case CommandBuffer::CommandType::SET_DEPTH_FUNC:
+                    state.depthFunc = (DepthFunc)command.value;
+                    break;
+                case CommandBuffer::CommandType::SET_DEPTH_PREPASS:
+                    state.depthPrepass = (DepthPrepass)command.value;
+                    break;
+                default:
+                    state.commandBuffer = commandBuffer;
+                    state.commandIndex = i;
+                    mDrawPackets.push_back(state);
+                    break;
+                }
+            }
+
+            // group the draws of a program so it is bound and cloned once
+            if (commandBuffer->getSortByProgram())
+            {
+                std::stable_sort(mDrawPackets.begin() + firstPacket, mDrawPackets.end(), [](const DrawPacket& a, const DrawPacket& b)
+                {
+                    return a.program->get() < b.program->get();
+                });
+            }
+        }
+
+        const uint8_t* boundUniforms = nullptr;
+        for (const auto& packet : mDrawPackets)
+        {
+            if (mProgram != *packet.program)
+            {
+                mProgram = *packet.program;
+                boundUniforms = nullptr;
+            }
+
+            // draws sharing a uniforms record skip the copy
+            if (packet.uniforms && packet.uniforms != boundUniforms)
+            {
+                mProgram->bindUniform(packet.uniforms, packet.uniformsSize);
+                boundUniforms = packet.uniforms;
+            }
+
+            mEnableDepthTest = packet.depthTest;
+            mEnableDepthMask = packet.depthWrite;
+            mDepthFunc = packet.depthFunc;
+            mDepthPrepass = packet.depthPrepass;
+
+            executeDrawPacket(packet);
+        }
+
+        // leave the state as the last command buffer recorded it
+        if (mProgram != *state.program)
+        {
+            mProgram = *state.program;
+            boundUniforms = nullptr;
+        }
+        if (state.uniforms && state.uniforms != boundUniforms)
+        {
+            mProgram->bindUniform(state.uniforms, state.uniformsSize);
+        }
+        mEnableDepthTest = state.depthTest;
+        mEnableDepthMask = state.depthWrite;
+        mDepthFunc = state.depthFunc;
+        mDepthPrepass = state.depthPrepass;
+    }
 
+    void Graphics::executeDrawPacket(const DrawPacket& packet)
+    {
+        const auto& command = packet.commandBuffer->getCommands()[packet.commandIndex];
+        switch (command.type)
+        {
+        case CommandBuffer::CommandType::DRAW_MESH:
+            drawMesh1(command.mesh);
+            break;
+        case CommandBuffer::CommandType::DRAW_MESH_CULLED:
+            drawMesh1(command.mesh, *reinterpret_cast<const glm::mat4*>(packet.commandBuffer->getData(command.dataOffset)));
+            break;
+        case CommandBuffer::CommandType::DRAW_SUB_MESH:
+            drawSubMesh(command.subMesh, command.first, command.count);
+            break;
+        case CommandBuffer::CommandType::DRAW_MESH_INSTANCED:
+            drawMeshInstanced(command.mesh, command.count, command.dataSize ? packet.commandBuffer->getData(command.dataOffset) : nullptr, command.stride);
+            break;
+        default:
+            break;
+        }
+    }
+}
@@ -1,16 +1,27 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
 #include <BS_thread_pool_light.hpp>
 
 #include "MathUtils.h"
 #include "Mesh.h"
 #include "Shader.h"
 #include "FrameBuffer.h"
+#include "FramePresenter.h"
 #include "Singleton.h"
 
 namespace SoftRenderer
 {
+    class CommandBuffer;
+
 #define SOFTGL_ALIGNMENT 32
+#define SOFTGL_TILE_SIZE 64
+#define SOFTGL_GUARD_BAND_SIZE 8192 // max screen coordinate of unclipped vertices, keeps the fixed-point edge functions in range
+#define SOFTGL_SUBPIXEL_BITS 8 // fractional bits of the fixed-point screen positions the rasterizer snaps vertices to
+#define SOFTGL_BLOCK_SIZE SOFTGL_HIZ_TILE_SIZE // raster blocks line up with the FrameBuffer Hi-Z tiles
 
     class Memory
     {
@@ -45,6 +56,82 @@ namespace SoftRenderer
         }
     };
 
+    // Bump allocator for transient pipeline memory that lives until the end of the frame.
+    // When a frame outgrows the first block, reset() merges the blocks into one, so steady frames never hit the heap.
+    class FrameArena
+    {
+    public:
+        explicit FrameArena(size_t blockSize = 1 << 20)
+            : mBlockSize(blockSize)
+        {
+        }
+
+        FrameArena(const FrameArena&) = delete;
+        FrameArena& operator=(const FrameArena&) = delete;
+
+        ~FrameArena()
+        {
+            for (auto& block : mBlocks)
+            {
+                Memory::alignedFree(block.data);
+            }
+        }
+
+        void* allocate(size_t size, size_t alignment = SOFTGL_ALIGNMENT)
+        {
+            if (!mBlocks.empty())
+            {
+                Block& block = mBlocks.back();
+                const size_t offset = (mOffset + alignment - 1) & ~(alignment - 1);
+                if (offset + size <= block.size)
+                {
+                    mOffset = offset + size;
+                    return block.data + offset;
+                }
+            }
+
+            const size_t blockSize = std::max(mBlockSize, size);
+            mBlocks.push_back({ static_cast<uint8_t*>(Memory::alignedMalloc(blockSize, std::max(alignment, (size_t)SOFTGL_ALIGNMENT))), blockSize });
+            mOffset = size;
+            return mBlocks.back().data;
+        }
+
+        template <typename T>
+        T* allocate(size_t count)
+        {
+            return static_cast<T*>(allocate(count * sizeof(T), std::max(alignof(T), (size_t)SOFTGL_ALIGNMENT)));
+        }
+
+        void reset()
+        {
+            if (mBlocks.size() > 1)
+            {
+                size_t totalSize = 0;
+                for (auto& block : mBlocks)
+                {
+                    totalSize += block.size;
+                    Memory::alignedFree(block.data);
+                }
+                mBlocks.clear();
+
+                mBlockSize = std::max(mBlockSize, totalSize);
+                mBlocks.push_back({ static_cast<uint8_t*>(Memory::alignedMalloc(mBlockSize)), mBlockSize });
+            }
+            mOffset = 0;
+        }
+
+    private:
+        struct Block
+        {
+            uint8_t* data;
+            size_t size;
+        };
+
+        std::vector<Block> mBlocks;
+        size_t mBlockSize;
+        size_t mOffset = 0;
+    };
+
     class Graphics : public Singleton<Graphics>
     {
         friend class Singleton<Graphics>;
@@ -75,6 +162,16 @@ namespace SoftRenderer
             DEPTH_ALWAYS,
         };
 
+        // Depth pre-pass: draw the frame with PREPASS_DEPTH_ONLY, then draw it again with PREPASS_SHADING,
+        // which shades with DEPTH_EQUAL and no depth writes so every pixel is shaded once.
+        // The depth-only pass never runs the fragment shader, so it uses the rasterized depth and ignores discard.
+        enum class DepthPrepass
+        {
+            PREPASS_DISABLED,
+            PREPASS_DEPTH_ONLY,
+            PREPASS_SHADING,
+        };
+
         struct FaceResource
         {
             int32_t indices[3]{ -1, -1, -1 };
@@ -85,28 +182,27 @@ namespace SoftRenderer
 
         using FaceBuffer = std::vector<FaceResource>;
 
-        struct VertexResource
+        // static geometry uploaded once by createBuffer, drawn through SubMesh::bufferId
+        struct BufferObject
         {
-            uint32_t id = 0;
-            Vertex  vertex = {};
-
-            float* varyings = nullptr;
+            std::vector<Vertex> vertices;
+            std::vector<uint32_t> indices;
+            FaceBuffer faces;
 
-            glm::vec4 position = glm::vec4(0);
-
-            //std::shared_ptr<float> varyings_append = nullptr;
-
-            uint32_t clip_mask = 0;
+            // vertices referenced by the whole index buffer, in first use order
+            std::vector<uint32_t> shadeList;
         };
 
-        using VertexBuffer = std::vector<VertexResource>;
-
         struct Fragment 
         {
             glm::aligned_vec4 position = glm::aligned_vec4(0);
             glm::aligned_vec4 barycentric = glm::aligned_vec4(0);
             float* interpolatedVaryings;
             bool inside = false;
+
+            // covered samples, and their rasterized depth when multisampling
+            uint32_t sampleMask = 0;
+            float sampleDepth[SOFTGL_MAX_SAMPLES];
         };
 
         struct FragmentQuad
@@ -123,11 +219,13 @@ namespace SoftRenderer
 
             // Triangular vertex screen space position
             glm::aligned_vec4 triangularVertexScreenPosition[3];
-            glm::aligned_vec4 triangularVertexScreenPositionFlat[4];
-            glm::aligned_vec4 triangularVertexClipZ = glm::aligned_vec4(1.0f);
+
+            // attribute setup: scaled by these, the edge functions are the perspective correct weights up to a common factor
+            glm::aligned_vec4 triangularVertexOneDivideClipZ = glm::aligned_vec4(1.0f);
+            glm::aligned_vec4 triangularVertexDepth = glm::aligned_vec4(0.0f);
+            glm::aligned_vec4 triangularVertexW = glm::aligned_vec4(0.0f);
             const float* triangularVertexVarings[3];
 
-            std::shared_ptr<float> interpolatedVaryingsBuffer = nullptr;
 
             bool front_facing = true;
 
@@ -136,15 +234,12 @@ namespace SoftRenderer
 
             }
 
-            void allocateVaryings(size_t varyingsAlignedSize = 0)
+            // buffer holds 4 slots of varyingsAlignedSize bytes, owned by the frame arena
+            void setVaryingsBuffer(float* buffer, size_t varyingsAlignedSize)
             {
-                if (varyingsAlignedSize > 0) 
+                for (int i = 0; i < 4; i++) 
                 {
-                    interpolatedVaryingsBuffer = std::shared_ptr<float>((float*)Memory::alignedMalloc(4 * varyingsAlignedSize), [](const float* ptr) { Memory::alignedFree((void*)ptr); });
-                    for (int i = 0; i < 4; i++) 
-                    {
-                        pixels[i].interpolatedVaryings = interpolatedVaryingsBuffer.get() + i * varyingsAlignedSize / 4;
-                    }
+                    pixels[i].interpolatedVaryings = buffer + i * varyingsAlignedSize / sizeof(float);
                 }
             }
 
@@ -173,29 +268,43 @@ namespace SoftRenderer
 
         struct RenderContex
         {
+            /**
+             * Vertex data of the current draw in one aligned structure-of-arrays arena:
+             *
+             *   | positions | clipPositions | clipMasks | varyings |
+             *
+             * The arena only grows, so steady state draws do not touch the heap.
+             */
+            RenderContex() = default;
+            RenderContex(const RenderContex&) = delete;
+            RenderContex& operator=(const RenderContex&) = delete;
+
+            ~RenderContex()
+            {
+                Memory::alignedFree(arena);
+            }
+
             inline static uint32_t calculateVaryingsAlignedSize(uint32_t varyCount) 
             {
                 return SOFTGL_ALIGNMENT * std::ceil(varyCount * sizeof(float) / (float)SOFTGL_ALIGNMENT);
             }
 
-            void createVertexBuffer(const std::vector<Vertex>& vertices)
+            void createVertexBuffer(const std::vector<Vertex>& inVertices, uint32_t varyCount)
             {
-                const size_t vertexCount = vertices.size();
-                vertexBuffer.resize(vertexCount);
+                vertices = inVertices.data();
+                vertexCount = 0;
 
-                for (int32_t i = 0; i < vertexCount; ++i)
-                {
-                    vertexBuffer[i].id = i;
-                    vertexBuffer[i].vertex = vertices[i];
-                    vertexBuffer[i].position = glm::vec4(0);
-                    vertexBuffer[i].varyings = nullptr;
-                    vertexBuffer[i].clip_mask = 0;
-                }
+                varyingsCount = varyCount;
+                varyingsAlignedSize = calculateVaryingsAlignedSize(varyingsCount);
+
+                // clipping appends vertices, reserve some room so it rarely regrows
+                reserveVertices((uint32_t)inVertices.size() + (uint32_t)inVertices.size() / 4, false);
+                vertexCount = (uint32_t)inVertices.size();
             }
 
-            void createIndexBuffer(const std::vector<uint32_t>& indices)
+            void createIndexBuffer(const uint32_t* indices, size_t indexCount)
             {
-                const size_t faceCount = indices.size() / 3;
+                const size_t faceCount = indexCount / 3;
                 faceBuffer.resize(faceCount);
 
                 for (int32_t i = 0; i < faceCount; ++i)
@@ -207,92 +316,103 @@ namespace SoftRenderer
                 }
             }
 
-            void allocVertexVaringMemory(uint32_t varyCount = 0)
+            inline float* getVaryings(int32_t index)
             {
-                varyingsCount = varyCount;
-                varyingsAlignedSize = varyingsCount * sizeof(float);
-                varyingsBuffer = nullptr;
-
-                if (varyingsAlignedSize > 0)
-                {
-                    //varyingsBuffer = std::shared_ptr<float>((float*)Memory::alignedMalloc(varyingsAlignedSize * vertexBuffer.size()), [](const float* ptr) { Memory::alignedFree((void*)ptr); });
-
-                    for (int32_t i = 0; i < vertexBuffer.size(); i++)
-                    {
-                        float* varyingsPtr = vertexBuffer[i].varyings;
-                        if(varyingsPtr)
-                        {
-                            Memory::alignedFree(varyingsPtr);
-                        }
-
-                        vertexBuffer[i].varyings = static_cast<float*>(Memory::alignedMalloc(varyingsAlignedSize));//varyingsBuffer.get() + i * varyingsAlignedSize / sizeof(float);
-                    }
-                }
+                return varyings + (size_t)index * varyingsAlignedSize / sizeof(float);
             }
 
-            void freeVertexVaringMemory()
+            // appends the vertex lerped in clip space between v0 and v1, returns its index
+            int32_t VertexHolderInterpolate(int32_t v0, int32_t v1, float weight) 
             {
-                for (int32_t i = 0; i < vertexBuffer.size(); i++)
+                if (vertexCount == vertexCapacity)
                 {
-                    float* varyingsPtr = vertexBuffer[i].varyings;
-                    if(varyingsPtr)
-                    {
-                        Memory::alignedFree(varyingsPtr);
-                    }
+                    reserveVertices(vertexCapacity * 2, true);
                 }
-            }
 
-            VertexResource VertexHolderInterpolate(VertexResource *v0, VertexResource *v1, float weight) 
-            {
-                VertexResource ret;
-                auto *vtf_ret = (float *) &ret.vertex;
-                auto *vtf_0 = (float *) &v0->vertex;
-                auto *vtf_1 = (float *) &v1->vertex;
-                for (int i = 0; i < sizeof(Vertex) / sizeof(float); i++)
+                const int32_t index = (int32_t)vertexCount++;
+
+                clipPositions[index] = glm::mix(clipPositions[v0], clipPositions[v1], weight);
+                clipMasks[index] = 0;
+
+                const float* vtf_0 = getVaryings(v0);
+                const float* vtf_1 = getVaryings(v1);
+                float* vtf_ret = getVaryings(index);
+
+                for (uint32_t i = 0; i < varyingsCount; i++)
                 {
                     vtf_ret[i] = glm::mix(vtf_0[i], vtf_1[i], weight);
                 }
 
-                ret.position = glm::mix(v0->position, v1->position, weight);
-                ret.clip_mask = 0;
-                
-                if (varyingsAlignedSize > 0) 
-                {
-                    //ret.varyings_append = std::shared_ptr<float>((float *) Memory::alignedMalloc(varyingsAlignedSize), [](const float *ptr) { Memory::alignedFree((void *) ptr); });
-                    ret.varyings = static_cast<float*>(Memory::alignedMalloc(varyingsAlignedSize));//ret.varyings_append.get();
-                }
-                
-                if(v0->varyings == nullptr)
-                {
-                    std::cout << v0->id << std::endl;
-                }
+                return index;
+            }
+
+            const Vertex* vertices = nullptr;
+            uint32_t vertexCount = 0;
+
+            // screen space position after perspective divide and viewport transform, w keeps clip w
+            glm::aligned_vec4* positions = nullptr;
+            glm::aligned_vec4* clipPositions = nullptr;
+            uint32_t* clipMasks = nullptr;
+            float* varyings = nullptr;
+
+            FaceBuffer faceBuffer;
 
-                if(v1->varyings == nullptr)
+            uint32_t varyingsCount = 0;
+            uint32_t varyingsAlignedSize = 0;
+
+        private:
+            static size_t alignSize(size_t size)
+            {
+                return (size + SOFTGL_ALIGNMENT - 1) & ~(size_t)(SOFTGL_ALIGNMENT - 1);
+            }
+
+            void reserveVertices(uint32_t capacity, bool keepContent)
+            {
+                capacity = std::max(capacity, 16u);
+                if (capacity <= vertexCapacity && varyingsAlignedSize == arenaVaryingsAlignedSize)
                 {
-                    std::cout << v1->id << std::endl;
+                    return;
                 }
 
-                vtf_0 = v0->varyings;
-                vtf_1 = v1->varyings;
+                capacity = std::max(capacity, vertexCapacity);
+
+                const size_t positionsSize = alignSize(capacity * sizeof(glm::aligned_vec4));
+                const size_t clipMasksSize = alignSize(capacity * sizeof(uint32_t));
+                const size_t varyingsSize = (size_t)capacity * varyingsAlignedSize;
 
-                for (int i = 0; i < varyingsAlignedSize / sizeof(float); i++)
+                auto* newArena = static_cast<uint8_t*>(Memory::alignedMalloc(2 * positionsSize + clipMasksSize + varyingsSize));
+                auto* newPositions = reinterpret_cast<glm::aligned_vec4*>(newArena);
+                auto* newClipPositions = reinterpret_cast<glm::aligned_vec4*>(newArena + positionsSize);
+                auto* newClipMasks = reinterpret_cast<uint32_t*>(newArena + 2 * positionsSize);
+                auto* newVaryings = reinterpret_cast<float*>(newArena + 2 * positionsSize + clipMasksSize);
+
+                if (keepContent && vertexCount > 0)
                 {
-                    ret.varyings[i] = glm::mix(vtf_0[i], vtf_1[i], weight);
+                    std::memcpy(newPositions, positions, vertexCount * sizeof(glm::aligned_vec4));
+                    std::memcpy(newClipPositions, clipPositions, vertexCount * sizeof(glm::aligned_vec4));
+                    std::memcpy(newClipMasks, clipMasks, vertexCount * sizeof(uint32_t));
+                    std::memcpy(newVaryings, varyings, (size_t)vertexCount * varyingsAlignedSize);
                 }
 
-                return ret;
-            }
+                Memory::alignedFree(arena);
 
-            VertexBuffer vertexBuffer;
-            FaceBuffer faceBuffer;
+                arena = newArena;
+                positions = newPositions;
+                clipPositions = newClipPositions;
+                clipMasks = newClipMasks;
+                varyings = newVaryings;
+                vertexCapacity = capacity;
+                arenaVaryingsAlignedSize = varyingsAlignedSize;
+            }
 
-            uint32_t varyingsCount = 0;
-            uint32_t varyingsAlignedSize = 0;
-            std::shared_ptr<float> varyingsBuffer = nullptr;
+            uint8_t* arena = nullptr;
+            uint32_t vertexCapacity = 0;
+            uint32_t arenaVaryingsAlignedSize = 0;
         };
 
     public:
-        void init(int width, int height);
+        // sampleCount > 1 renders with SOFTGL_MAX_SAMPLES samples per pixel, resolved by swapBuffer
+        void init(int width, int height, FrameBufferLayout layout = FrameBufferLayout::LINEAR, uint32_t sampleCount = 1);
 
         void setViewport(int32_t x, int32_t y, int32_t width, int32_t height);
 
@@ -304,14 +424,44 @@ namespace SoftRenderer
 
         void drawMesh1(const Mesh* mesh);
 
+        // skips sub meshes whose bounds are outside the frustum of modelViewProject before vertex shading
+        void drawMesh1(const Mesh* mesh, const glm::mat4& modelViewProject);
+
+        // draws indexCount indices from firstIndex, only the vertices they reference are shaded
+        void drawSubMesh(const SubMesh* subMesh, uint32_t firstIndex = 0, uint32_t indexCount = UINT32_MAX);
+
+        // draws instanceCount copies of mesh sharing one vertex setup, the vertex shader of instance i
+        // sees gl_InstanceID = i and gl_InstanceData = instanceData + i * instanceDataStride
+        void drawMeshInstanced(const Mesh* mesh, uint32_t instanceCount, const void* instanceData, size_t instanceDataStride);
+
+        // returns a handle for SubMesh::bufferId, 0 is never a valid handle
+        uint32_t createBuffer(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+        void deleteBuffer(uint32_t bufferId);
+
+        // uploads every sub mesh into a buffer object, later draws skip the per draw index conversion
+        void createBuffers(Mesh* mesh);
+
+        void deleteBuffers(Mesh* mesh);
+
         void clearColor(const glm::vec4& color);
 
         void clearDepth(float depth);
 
+        // clears color and depth of the back buffer, tiles are only filled once they are drawn to or read back
+        void clearColorDepth(const glm::vec4& color, float depth);
+
         void swapBuffer();
 
         FrameBuffer::Ptr& getOutput();
 
+        // pipelined frames: swapBuffer hands the frame to presentFunc on a present thread and rendering
+        // continues into a free buffer of a ring of frameCount buffers; a null presentFunc turns it off
+        void setFramePresenter(FramePresenter::PresentFunc presentFunc, uint32_t frameCount = 3);
+
+        // blocks until every swapped frame has been presented
+        void waitFramePresenter();
+
         void setModelMatrix(const glm::mat4& mat);
 
         void setViewMatrix(const glm::mat4& mat);
@@ -330,21 +480,46 @@ namespace SoftRenderer
 
         void setDepthFunc(DepthFunc func);
 
+        void setDepthPrepass(DepthPrepass prepass);
+
+        // executes the recorded commands in order, state left by one command buffer carries over to the next
+        void submit(const CommandBuffer& commandBuffer);
+
+        void submit(const std::vector<const CommandBuffer*>& commandBuffers);
+
+        void submit(const CommandBuffer* const* commandBuffers, size_t commandBufferCount);
+
     private:
-        void uploadVertexData(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+        void uploadVertexData(const std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount);
 
-        void processVertexShader();
+        bool uploadSubMesh(const SubMesh* subMesh, uint32_t firstIndex, uint32_t indexCount);
 
-        void processFrustumClip();
+        void uploadBufferData(const BufferObject& buffer, uint32_t firstIndex, uint32_t indexCount);
 
-        void processPerspectiveDivide();
+        void buildShadeList(const uint32_t* indices, size_t indexCount);
 
-        void processViewportTransform();
+        const BufferObject* getBuffer(uint32_t bufferId) const;
+
+        void processVertexShader();
+
+        void processFrustumClip();
 
         void processBackFaceCulling();
 
         void processRasterization();
 
+        void processTileBinning();
+
+        bool isBoundsCulled(const BoxSphereBounds& bounds, const glm::mat4& modelViewProject) const;
+
+        void updateThreadPrograms();
+
+        FrameBuffer::Ptr acquireFrameBuffer();
+
+        struct DrawPacket;
+
+        void executeDrawPacket(const DrawPacket& packet);
+
         void ProcessFaceWireframe();
 
     private:
@@ -356,14 +531,24 @@ namespace SoftRenderer
 
         void viewportTransform1(glm::vec4& pos);
 
-        void perspectiveCorrectInterpolation(FragmentQuad& quad);
+        void clipToScreen(int32_t index);
 
-        void varyingInterpolate(float* out_vary, const float* in_varyings[], size_t elem_cnt, glm::aligned_vec4& bc);
+        // edges: per pixel edge functions opposite to each vertex, the same that decide coverage.
+        // sampleEdgeOffsets: edge function steps from the pixel center to each sample, to fill Fragment::sampleDepth
+        void perspectiveCorrectInterpolation(FragmentQuad& quad, const glm::vec3 edges[4], const glm::vec3* sampleEdgeOffsets = nullptr);
+
+        // interpolates the varyings of all four quad pixels, including the padding of their aligned slots
+        void varyingInterpolateQuad(FragmentQuad& quad);
 
         bool depthTest(uint32_t x, uint32_t y, float depth);
 
+        // returns the samples of sampleMask that pass
+        uint32_t depthTestSamples(uint32_t x, uint32_t y, const float* depth, uint32_t sampleMask);
+
         bool depthFuncTest(float z, float depth, DepthFunc func);
 
+        bool hiZOccluded(uint32_t tileX, uint32_t tileY, float minDepth, float maxDepth);
+
         float interpolateDepth(const std::array<float, 3>& screenDepth, const glm::vec3& weight);
 
         bool edgeFunction(const glm::ivec2& a, const glm::ivec2& b, const glm::ivec2& c);
@@ -374,7 +559,7 @@ namespace SoftRenderer
 
         void rasterizeTriangle3(const Shader::VertexData& vertex0, const Shader::VertexData& vertex1, const Shader::VertexData& vertex2);
 
-        void rasterizeTriangle4(FaceResource& face);
+        void rasterizeTriangle4(FaceResource& face, FragmentQuad& fragementQuad, const glm::ivec4& tileRect);
 
         void rasterizeTopTriangle(const Shader::VertexData& v0, const Shader::VertexData& v1, const Shader::VertexData& v2);
 
@@ -382,7 +567,11 @@ namespace SoftRenderer
 
         void scanLine(const Shader::VertexData& left, const Shader::VertexData& right);
 
-        void pixelShading(FragmentQuad& fragementQuad);
+        // depth test before shading, clears inside for hidden pixels and returns true if any pixel is left
+        bool earlyDepthTestQuad(FragmentQuad& fragementQuad);
+
+        // depthTested skips the depth test after early-z
+        void pixelShading(FragmentQuad& fragementQuad, bool depthTested = false);
 
 
     private:
@@ -391,17 +580,32 @@ namespace SoftRenderer
         FrameBuffer::Ptr mBackBuffer;
         FrameBuffer::Ptr mFrontBuffer;
 
+        // frame buffers of the pipeline, the front buffer and frames in flight are never rendered to
+        std::vector<FrameBuffer::Ptr> mFrameRing;
+        std::unique_ptr<FramePresenter> mFramePresenter;
+
         int mWidth;
         int mHeight;
+        FrameBufferLayout mFrameBufferLayout = FrameBufferLayout::LINEAR;
+        uint32_t mSampleCount = 1;
 
         Viewport mViewport;
         DepthRange mDepthRange;
         DepthFunc mDepthFunc = DepthFunc::DEPTH_GREATER; // Reversed-Z
         bool mEnableDepthTest = true;
         bool mEnableDepthMask = true;
+        DepthPrepass mDepthPrepass = DepthPrepass::PREPASS_DISABLED;
+
+        // depth state used by the current draw, after applying the depth pre-pass stage
+        DepthFunc mRasterDepthFunc = DepthFunc::DEPTH_GREATER;
+        bool mRasterDepthMask = true;
 
         bool mEnableBackfaceCull = true;
         bool mEnableFrustumClip = true;
+        bool mEnableGuardBand = true;
+
+        // guard band in ndc, derived from the viewport
+        glm::vec2 mGuardBand = glm::vec2(1.0f);
 
         RenderContex mRenderContex;
 
@@ -411,5 +615,52 @@ namespace SoftRenderer
 
         std::vector<FragmentQuad> mFragmentQuad;
 
+        std::unordered_map<std::thread::id, uint32_t> mThreadIdMap;
+
+        // per thread clones of mThreadProgramsSource, cloned again only when another program is bound
+        std::vector<std::shared_ptr<Program>> mThreadPrograms;
+        std::shared_ptr<Program> mThreadProgramsSource = nullptr;
+
+        // screen tiles of SOFTGL_TILE_SIZE pixels, the faces of tile i are
+        // mTileBinFaces[mTileBinOffsets[i], mTileBinOffsets[i + 1]) in submission order
+        int32_t mTileCountX = 0;
+        int32_t mTileCountY = 0;
+        uint32_t* mTileBinOffsets = nullptr;
+        uint32_t* mTileBinFaces = nullptr;
+
+        // post-transform cache: a vertex is shaded once per draw, when its tag is not the draw's tag yet
+        std::vector<uint32_t> mVertexCacheTags;
+        uint32_t mVertexCacheTag = 0;
+
+        // vertices referenced by the draw in first use order, the vertex stage shades only these
+        const uint32_t* mShadeList = nullptr;
+        uint32_t mShadeCount = 0;
+
+        // instance of the current draw, faces are restored from mInstanceFaces for every instance
+        uint32_t mInstanceID = 0;
+        const void* mInstanceData = nullptr;
+        FaceBuffer mInstanceFaces;
+
+        // draws of submit with the state they were recorded with
+        struct DrawPacket
+        {
+            const CommandBuffer* commandBuffer;
+            uint32_t commandIndex;
+            const std::shared_ptr<Program>* program;
+            const uint8_t* uniforms;
+            uint32_t uniformsSize;
+            bool depthTest;
+            bool depthWrite;
+            DepthFunc depthFunc;
+            DepthPrepass depthPrepass;
+        };
+        std::vector<DrawPacket> mDrawPackets;
+
+        // buffer object of handle id is mBuffers[id - 1], deleted ones are null
+        std::vector<std::unique_ptr<BufferObject>> mBuffers;
+
+        // transient memory of the frame: bins, quad varyings, shade lists; reset by swapBuffer
+        FrameArena mFrameArena;
+
     };
 }
\ No newline at end of file
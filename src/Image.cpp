@@ -147,13 +147,14 @@ namespace SoftRenderer
 
     bool Image::save(const std::string& filename, SaveFormat saveformat)
     {
+        int result = 0;
         switch (saveformat)
         {
         case SaveFormat::PNG:
-            stbi_write_png(filename.c_str(), mWidth, mHeight, getComponent(), mData, mWidth * getComponent());
+            result = stbi_write_png(filename.c_str(), mWidth, mHeight, getComponent(), mData, mWidth * getComponent());
             break;
         case SaveFormat::JPG:
-            stbi_write_jpg(filename.c_str(), mWidth, mHeight, getComponent(), mData, 100);
+            result = stbi_write_jpg(filename.c_str(), mWidth, mHeight, getComponent(), mData, 100);
             break;
         case SaveFormat::BMP:
             break;
@@ -163,7 +164,7 @@ namespace SoftRenderer
             break;
         }
 
-        return true;
+        return result != 0;
     }
 
     //using template generates perfectly optimized code due to constant expression reduction and unused variable removal present in all compilers
@@ -1,5 +1,6 @@
 #include "Material.h"
 #include "Graphics.h"
+#include "CommandBuffer.h"
 #include "ShaderManagement.h"
 
 namespace SoftRenderer
@@ -79,6 +80,11 @@ namespace SoftRenderer
         Graphics::instance().useProgram(mProgram);
     }
 
+    void Material::bind(CommandBuffer& commandBuffer)
+    {
+        commandBuffer.useProgram(mProgram);
+    }
+
     void Material::unbind()
     {
         
@@ -140,27 +146,40 @@ namespace SoftRenderer
         mAOTexture = aoTexture;
     }
 
+    void BlinnPhongMaterial::updateUniforms()
+    {
+        mUniforms->diffuseColor      = mDiffuseColor;
+        mUniforms->specularColor     = mSpecularColor;
+        mUniforms->specularShininess = mSpecularShininess;
+        mUniforms->specularStrength  = mSpecularStrength; 
+
+        if(mEmissiveTexture) mUniforms->emissiveMap.bindTexture(mEmissiveTexture.get());
+        if(mDiffuseTexture)  mUniforms->diffuseMap.bindTexture(mDiffuseTexture.get());
+        if(mNormalTexture)   mUniforms->normalMap.bindTexture(mNormalTexture.get());
+        if(mAOTexture)       mUniforms->aoMap.bindTexture(mAOTexture.get());
+    }
+
     void BlinnPhongMaterial::updateParameters()
     {
         if(mProgram != nullptr)
         {
             if(mUniforms != nullptr)
             {
-                mUniforms->diffuseColor      = mDiffuseColor;
-                mUniforms->specularColor     = mSpecularColor;
-                mUniforms->specularShininess = mSpecularShininess;
-                mUniforms->specularStrength  = mSpecularStrength; 
-
-                if(mEmissiveTexture) mUniforms->emissiveMap.bindTexture(mEmissiveTexture.get());
-                if(mDiffuseTexture)  mUniforms->diffuseMap.bindTexture(mDiffuseTexture.get());
-                if(mNormalTexture)   mUniforms->normalMap.bindTexture(mNormalTexture.get());
-                if(mAOTexture)       mUniforms->aoMap.bindTexture(mAOTexture.get());
-
+                updateUniforms();
                 mProgram->bindUniform(mUniforms.get(), sizeof(BlinnPhongShader::ShaderUniforms));
             }
         }
     }
 
+    void BlinnPhongMaterial::updateParameters(CommandBuffer& commandBuffer)
+    {
+        if(mUniforms != nullptr)
+        {
+            updateUniforms();
+            commandBuffer.setUniforms(mUniforms.get(), sizeof(BlinnPhongShader::ShaderUniforms));
+        }
+    }
+
     SkyboxMaterial::SkyboxMaterial()
     {
         mProgram = ShaderManager::instance().getShaderProgram("Skybox");
@@ -185,22 +204,35 @@ namespace SoftRenderer
         mCubemapTextures[(int)face] = texture;
     }
 
+    void SkyboxMaterial::updateUniforms()
+    {
+        if(mCubemapTextures[0]) mUniforms->cubeMap.bindTexture(mCubemapTextures[0].get(), CubeMapFace::TEXTURE_CUBE_MAP_POSITIVE_X);
+        if(mCubemapTextures[1]) mUniforms->cubeMap.bindTexture(mCubemapTextures[1].get(), CubeMapFace::TEXTURE_CUBE_MAP_NEGATIVE_X);
+        if(mCubemapTextures[2]) mUniforms->cubeMap.bindTexture(mCubemapTextures[2].get(), CubeMapFace::TEXTURE_CUBE_MAP_POSITIVE_Y);
+        if(mCubemapTextures[3]) mUniforms->cubeMap.bindTexture(mCubemapTextures[3].get(), CubeMapFace::TEXTURE_CUBE_MAP_NEGATIVE_Y);
+        if(mCubemapTextures[4]) mUniforms->cubeMap.bindTexture(mCubemapTextures[4].get(), CubeMapFace::TEXTURE_CUBE_MAP_POSITIVE_Z);
+        if(mCubemapTextures[5]) mUniforms->cubeMap.bindTexture(mCubemapTextures[5].get(), CubeMapFace::TEXTURE_CUBE_MAP_NEGATIVE_Z);
+    }
+
     void SkyboxMaterial::updateParameters()
     {
         if(mProgram != nullptr)
         {
             if(mUniforms != nullptr)
             {
-                if(mCubemapTextures[0]) mUniforms->cubeMap.bindTexture(mCubemapTextures[0].get(), CubeMapFace::TEXTURE_CUBE_MAP_POSITIVE_X);
-                if(mCubemapTextures[1]) mUniforms->cubeMap.bindTexture(mCubemapTextures[1].get(), CubeMapFace::TEXTURE_CUBE_MAP_NEGATIVE_X);
-                if(mCubemapTextures[2]) mUniforms->cubeMap.bindTexture(mCubemapTextures[2].get(), CubeMapFace::TEXTURE_CUBE_MAP_POSITIVE_Y);
-                if(mCubemapTextures[3]) mUniforms->cubeMap.bindTexture(mCubemapTextures[3].get(), CubeMapFace::TEXTURE_CUBE_MAP_NEGATIVE_Y);
-                if(mCubemapTextures[4]) mUniforms->cubeMap.bindTexture(mCubemapTextures[4].get(), CubeMapFace::TEXTURE_CUBE_MAP_POSITIVE_Z);
-                if(mCubemapTextures[5]) mUniforms->cubeMap.bindTexture(mCubemapTextures[5].get(), CubeMapFace::TEXTURE_CUBE_MAP_NEGATIVE_Z);
-
+                updateUniforms();
                 mProgram->bindUniform(mUniforms.get(), sizeof(SkyboxShader::ShaderUniforms));
             }
         }
     }
 
+    void SkyboxMaterial::updateParameters(CommandBuffer& commandBuffer)
+    {
+        if(mUniforms != nullptr)
+        {
+            updateUniforms();
+            commandBuffer.setUniforms(mUniforms.get(), sizeof(SkyboxShader::ShaderUniforms));
+        }
+    }
+
 }
\ No newline at end of file
@@ -6,6 +6,8 @@
 
 namespace SoftRenderer
 {
+    class CommandBuffer;
+
     class Material
     {
     public:
@@ -28,6 +30,9 @@ namespace SoftRenderer
         void bind();
         void unbind();
 
+        // records the program into commandBuffer instead of binding it
+        void bind(CommandBuffer& commandBuffer);
+
     protected:
         std::shared_ptr<Program>            mProgram  = nullptr;
     };
@@ -75,7 +80,12 @@ namespace SoftRenderer
 
         void updateParameters();
 
+        // records the uniforms into commandBuffer, the material may be changed again right after
+        void updateParameters(CommandBuffer& commandBuffer);
+
     private:
+        void updateUniforms();
+
         std::shared_ptr<BlinnPhongShader::ShaderUniforms> mUniforms = nullptr;
 
 
@@ -103,7 +113,12 @@ namespace SoftRenderer
 
         void updateParameters();
 
+        // records the uniforms into commandBuffer, the material may be changed again right after
+        void updateParameters(CommandBuffer& commandBuffer);
+
     private:
+        void updateUniforms();
+
         std::shared_ptr<SkyboxShader::ShaderUniforms> mUniforms = nullptr;
 
         std::array<std::shared_ptr<Texture>, 6> mCubemapTextures;
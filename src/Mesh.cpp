@@ -22,12 +22,15 @@ namespace SoftRenderer
     {
         this->vertices = vertices;
         this->indices = indices;
+
+        updateBounds();
     }
 
     SubMesh::SubMesh(const SubMesh& mesh)
     {
         this->vertices = mesh.vertices;
         this->indices = mesh.indices;
+        this->bounds = mesh.bounds;
     }
 
     SubMesh& SubMesh::operator=(const SubMesh& mesh)
@@ -38,6 +41,7 @@ namespace SoftRenderer
         }
         this->vertices = mesh.vertices;
         this->indices = mesh.indices;
+        this->bounds = mesh.bounds;
         return *this;
     }
 
@@ -51,6 +55,9 @@ namespace SoftRenderer
         indices.push_back(size);
         indices.push_back(size + 1);
         indices.push_back(size + 2);
+
+        const BoxSphereBounds triangleBounds(std::vector<glm::vec3>{ v0.position, v1.position, v2.position });
+        bounds = vertices.size() == 3 ? triangleBounds : bounds + triangleBounds;
     }
 
     SubMesh& SubMesh::setPositions(const std::vector<glm::vec3>& positions)
@@ -97,7 +104,7 @@ namespace SoftRenderer
     SubMesh& SubMesh::build()
     {
         if (indices.empty() || positions.empty())
-            return SubMesh();
+            return *this;
 
         for (int i = 0; i < positions.size(); i++)
         {
@@ -142,11 +149,24 @@ namespace SoftRenderer
             }
         }
 
+        return updateBounds();
+    }
+
+    SubMesh& SubMesh::updateBounds()
+    {
+        Box box;
+        for (const auto& vertex : vertices)
+        {
+            box += vertex.position;
+        }
+
+        bounds = BoxSphereBounds(box);
         return *this;
     }
 
     void Mesh::addSubMesh(std::shared_ptr<SubMesh> subMesh)
     {
+        mBounds = subMeshs.empty() ? subMesh->bounds : mBounds + subMesh->bounds;
         subMeshs.push_back(subMesh);
     }
 
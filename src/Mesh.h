@@ -69,6 +69,9 @@ namespace SoftRenderer
         SubMesh& setUVs(const std::vector<glm::vec2>& uvs);
         SubMesh& setIndices(const std::vector<uint32_t>& indices);
         SubMesh& build();
+
+        // recomputes bounds from the vertex positions
+        SubMesh& updateBounds();
     
         std::vector<Vertex> vertices;
         std::vector<uint32_t> indices;
@@ -82,6 +85,9 @@ namespace SoftRenderer
         uint32_t flag = 0;
 
         uint32_t bufferId = 0;
+
+        // object space bounds of the vertices
+        BoxSphereBounds bounds = BoxSphereBounds(glm::vec3(0.0f), glm::vec3(0.0f), 0.0f);
     };
 
     class Mesh
@@ -98,7 +104,8 @@ namespace SoftRenderer
         static std::shared_ptr<Mesh> createTorusKnot(float radius, float tube, uint32_t tubularSegments, uint32_t radialSegments, uint32_t p, uint32_t q);
 
     public:
-        BoxSphereBounds mBounds;
+        // union of the sub mesh bounds
+        BoxSphereBounds mBounds = BoxSphereBounds(glm::vec3(0.0f), glm::vec3(0.0f), 0.0f);
 
         std::vector<std::shared_ptr<SubMesh>> subMeshs;
     };
@@ -0,0 +1,75 @@
+#include "SIMD.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if SOFTGL_SIMD_X86 && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace SoftRenderer
+{
+    static SIMDLevel detectSIMDLevel()
+    {
+#if SOFTGL_SIMD_X86 && defined(_MSC_VER)
+        int info[4] = {};
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        const bool sse41 = (info[2] & (1 << 19)) != 0;
+        const bool fma = (info[2] & (1 << 12)) != 0;
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+
+        bool avx2 = false;
+        if (maxLeaf >= 7 && osxsave && fma && (_xgetbv(0) & 0x6) == 0x6)
+        {
+            __cpuidex(info, 7, 0);
+            avx2 = (info[1] & (1 << 5)) != 0;
+        }
+
+        if (avx2)
+            return SIMDLevel::SIMD_AVX2;
+        if (sse41)
+            return SIMDLevel::SIMD_SSE41;
+#elif SOFTGL_SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return SIMDLevel::SIMD_AVX2;
+        if (__builtin_cpu_supports("sse4.1"))
+            return SIMDLevel::SIMD_SSE41;
+#endif
+        return SIMDLevel::SIMD_NONE;
+    }
+
+    SIMDLevel SIMD::getLevel()
+    {
+        static const SIMDLevel level = []()
+        {
+            SIMDLevel detected = detectSIMDLevel();
+
+            // SOFTGL_SIMD=none|sse4.1 caps the level, to compare kernels on the same machine
+            const char* cap = std::getenv("SOFTGL_SIMD");
+            if (cap != nullptr)
+            {
+                if (std::strcmp(cap, "none") == 0)
+                    detected = SIMDLevel::SIMD_NONE;
+                else if (std::strcmp(cap, "sse4.1") == 0 && detected > SIMDLevel::SIMD_SSE41)
+                    detected = SIMDLevel::SIMD_SSE41;
+            }
+            return detected;
+        }();
+        return level;
+    }
+
+    const char* SIMD::getLevelName(SIMDLevel level)
+    {
+        switch (level)
+        {
+        case SIMDLevel::SIMD_AVX2: return "AVX2";
+        case SIMDLevel::SIMD_SSE41: return "SSE4.1";
+        case SIMDLevel::SIMD_NONE: return "none";
+        }
+        return "none";
+    }
+}
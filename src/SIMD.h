@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SOFTGL_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define SOFTGL_SIMD_X86 0
+#endif
+
+// Kernels for a wider instruction set than the build baseline are compiled per function,
+// and only called after checking the running cpu.
+#if SOFTGL_SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+#define SOFTGL_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define SOFTGL_TARGET_AVX2  __attribute__((target("avx2,fma")))
+#else
+#define SOFTGL_TARGET_SSE41
+#define SOFTGL_TARGET_AVX2
+#endif
+
+namespace SoftRenderer
+{
+    enum class SIMDLevel
+    {
+        SIMD_NONE,
+        SIMD_SSE41,
+        SIMD_AVX2,
+    };
+
+    class SIMD
+    {
+    public:
+        // highest level supported by both the cpu and the os, detected once
+        static SIMDLevel getLevel();
+
+        static const char* getLevelName(SIMDLevel level);
+    };
+}
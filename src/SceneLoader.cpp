@@ -108,15 +108,6 @@ namespace SoftRenderer
         return true;
     }
 
-    BoxSphereBounds convertBoundingBox(const aiAABB &aabb, const aiMatrix4x4& meshTransform) 
-    {
-        aiVector3D bmin = meshTransform * aabb.mMin;
-        aiVector3D bmax = meshTransform * aabb.mMax;
-        Box box(glm::vec3(bmin.x, bmin.y, bmin.z), glm::vec3(bmax.x, bmax.y, bmax.z));
-        BoxSphereBounds bound(box);
-        return bound;
-    }
-
     glm::mat4 convertMatrix(const aiMatrix4x4& m) 
     {
         glm::mat4 ret;
@@ -237,8 +228,8 @@ namespace SoftRenderer
 
         std::shared_ptr<SubMesh> submesh = std::make_shared<SubMesh>(vertexes, indices);
 
+        // bounds come from the transformed vertices, the Assimp AABB is in mesh space
         outMesh->addSubMesh(submesh);
-        outMesh->mBounds += convertBoundingBox(inMesh->mAABB, meshTransform);
 
         return true;
     }
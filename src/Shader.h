@@ -187,10 +187,21 @@ namespace SoftRenderer
     public:
         // Built-in variables
         glm::vec4 gl_Position;
+        int32_t gl_InstanceID = 0;
+
+        // per instance data of Graphics::drawMeshInstanced, nullptr outside instanced draws
+        const void* gl_InstanceData = nullptr;
 
         virtual std::shared_ptr<BaseVertexShader> clone() = 0;
     };
 
+    // Like the GLSL conservative depth layout qualifier of gl_FragDepth
+    enum class FragDepthLayout
+    {
+        DEPTH_ANY,          // gl_FragDepth may be written with any value
+        DEPTH_UNCHANGED,    // gl_FragDepth keeps the rasterized depth
+    };
+
     class BaseFragmentShader : public BaseShader
     {
     public:
@@ -201,6 +212,19 @@ namespace SoftRenderer
         glm::vec4 gl_FragColor;
         bool discard = false;
 
+        // index of the shaded pixel in its FragmentQuad
+        int32_t gl_QuadPixelIndex = 0;
+
+        // runs once per FragmentQuad before shaderMain of its pixels, with the ShaderVaryings of all four pixels,
+        // so shaders can share quad work like Sampler2D::texture2DQuad
+        virtual void shaderQuadMain(void* const /*varyings*/[4]) {}
+
+        // shaders that never touch gl_FragDepth override this, so depth can be tested before shading
+        virtual FragDepthLayout getFragDepthLayout() const { return FragDepthLayout::DEPTH_ANY; }
+
+        // shaders that never set discard override this, together with DEPTH_UNCHANGED it enables early depth test
+        virtual bool usesDiscard() const { return true; }
+
         virtual std::shared_ptr<BaseFragmentShader> clone() = 0;
     };
 
@@ -287,7 +311,7 @@ namespace SoftRenderer
             vertexShader->bindShaderAttributes(ptr);
         }
 
-        void bindUniform(void *data, size_t len) 
+        void bindUniform(const void *data, size_t len) 
         {
             memcpy(uniforms.get(), data, len);
         }
@@ -328,6 +352,14 @@ namespace SoftRenderer
             }
         }
 
+        void executeFragmentShaderQuad(void* const varyings[4])
+        {
+            if(fragmentShader)
+            {
+                fragmentShader->shaderQuadMain(varyings);
+            }
+        }
+
         std::shared_ptr<Program> clone() const 
         {
             auto ret = std::make_shared<Program>(*this);
@@ -73,6 +73,8 @@ namespace SoftRenderer
                 }
             }
 
+            FragDepthLayout getFragDepthLayout() const override { return FragDepthLayout::DEPTH_UNCHANGED; }
+
             CLONE_FRAGMENT_SHADER(SkyboxFragmentShader)
         };
     }
@@ -126,6 +126,8 @@ void main()
 
     Graphics& render = Graphics::instance();
     render.init(500, 500);
+    render.createBuffers(box.get());
+    render.createBuffers(mesh.get());
 
     BlinnPhongMaterial modelMaterial;
 
@@ -181,11 +183,15 @@ void main()
     skyboxMatrial.setCubemapTexture(backTexture, CubeMapFace::TEXTURE_CUBE_MAP_NEGATIVE_Z);
 
 
+    render.setFramePresenter([&](const FrameBuffer::Ptr& frameBuffer)
+    {
+        window->drawBuffer(frameBuffer);
+    });
+
     while (!window->shouldClose())
     {
         render.setViewport(0, 0, 500, 500);
-        render.clearColor(glm::vec4(0.1, 0.1, 0.1, 1.0));
-        render.clearDepth(0.0f);
+        render.clearColorDepth(glm::vec4(0.1, 0.1, 0.1, 1.0), 0.0f);
 
         auto light_position = 2.f * glm::vec3(glm::sin(light_position_angle),
                                     0.0f,
@@ -193,13 +199,14 @@ void main()
 
         modelMaterial.bind();
         modelMaterial.setModelMatrix(modelMat);
-        modelMaterial.setModelViewProjectMatrix(camera.getProjMatrix() * camera.getViewMatrix() * modelMat);
+        const glm::mat4 modelMVP = camera.getProjMatrix() * camera.getViewMatrix() * modelMat;
+        modelMaterial.setModelViewProjectMatrix(modelMVP);
         modelMaterial.setInverseTransposeModelMatrix(glm::mat3(glm::transpose(glm::inverse(modelMat))));
         modelMaterial.setLightPosition(light_position);
         modelMaterial.setLightColor(glm::vec3(1.0f, 0.0f, 0.0f));
         modelMaterial.setCameraPosition(camera.getEye());
         modelMaterial.updateParameters();
-        render.drawMesh1(box.get());
+        render.drawMesh1(box.get(), modelMVP);
 
 
         skyboxMatrial.bind();
@@ -209,14 +216,13 @@ void main()
         skyboxMatrial.updateParameters();
         render.drawMesh1(mesh.get());
 
+        // presented on the present thread while the next frame renders
         render.swapBuffer();
 
         auto now = std::chrono::steady_clock::now();
         auto time = std::chrono::duration<double>(now - start).count();
         //std::cout << time << std::endl;
 
-        window->drawBuffer(render.getOutput());
-
         window->pollEvent();
 
         m_deltaTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - m_lastTimePoint).count();
@@ -240,4 +246,7 @@ void main()
         }
     }
 
+    // the present thread still uses the window
+    render.setFramePresenter(nullptr);
+
 }
\ No newline at end of file
@@ -0,0 +1,297 @@
+#include <chrono>
+#include <array>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <iomanip>
+
+#include "FrameBuffer.h"
+#include "Mesh.h"
+#include "Camera.h"
+#include "MathUtils.h"
+#include "Graphics.h"
+#include "Utils.h"
+#include "Image.h"
+#include "Texture.h"
+#include "SceneLoader.h"
+#include "ShaderManagement.h"
+#include "Material.h"
+#include "CommandBuffer.h"
+#include "BlinnPhongShader.h"
+#include "SIMD.h"
+
+using namespace SoftRenderer;
+
+// Headless entry point: renders into the back buffer of Graphics without creating a window.
+// usage: SoftRendererHeadless [--depth-prepass] [--tiled-framebuffer] [--msaa] [--instances N] [--save-frames prefix] [width] [height] [frames] [output.png] [model]
+
+float skyboxVertices[] = {
+    // positions
+    -1.0f, 1.0f, -1.0f,
+    -1.0f, -1.0f, -1.0f,
+    1.0f, -1.0f, -1.0f,
+    1.0f, -1.0f, -1.0f,
+    1.0f, 1.0f, -1.0f,
+    -1.0f, 1.0f, -1.0f,
+
+    -1.0f, -1.0f, 1.0f,
+    -1.0f, -1.0f, -1.0f,
+    -1.0f, 1.0f, -1.0f,
+    -1.0f, 1.0f, -1.0f,
+    -1.0f, 1.0f, 1.0f,
+    -1.0f, -1.0f, 1.0f,
+
+    1.0f, -1.0f, -1.0f,
+    1.0f, -1.0f, 1.0f,
+    1.0f, 1.0f, 1.0f,
+    1.0f, 1.0f, 1.0f,
+    1.0f, 1.0f, -1.0f,
+    1.0f, -1.0f, -1.0f,
+
+    -1.0f, -1.0f, 1.0f,
+    -1.0f, 1.0f, 1.0f,
+    1.0f, 1.0f, 1.0f,
+    1.0f, 1.0f, 1.0f,
+    1.0f, -1.0f, 1.0f,
+    -1.0f, -1.0f, 1.0f,
+
+    -1.0f, 1.0f, -1.0f,
+    1.0f, 1.0f, -1.0f,
+    1.0f, 1.0f, 1.0f,
+    1.0f, 1.0f, 1.0f,
+    -1.0f, 1.0f, 1.0f,
+    -1.0f, 1.0f, -1.0f,
+
+    -1.0f, -1.0f, -1.0f,
+    -1.0f, -1.0f, 1.0f,
+    1.0f, -1.0f, -1.0f,
+    1.0f, -1.0f, -1.0f,
+    -1.0f, -1.0f, 1.0f,
+    1.0f, -1.0f, 1.0f
+};
+
+std::shared_ptr<Mesh> createSkyboxMesh()
+{
+    std::vector<uint32_t> indices;
+    std::vector<glm::vec3> positions;
+
+    for (int i = 0; i < 12; i++) {
+        for (int j = 0; j < 3; j++)
+        {
+            glm::vec3 position;
+            position.x = skyboxVertices[i * 9 + j * 3 + 0];
+            position.y = skyboxVertices[i * 9 + j * 3 + 1];
+            position.z = skyboxVertices[i * 9 + j * 3 + 2];
+            positions.push_back(position);
+            indices.push_back(i * 3 + j);
+        }
+    }
+
+    std::shared_ptr<SubMesh> submesh = std::make_shared<SubMesh>();
+    submesh->setPositions(positions);
+    submesh->setIndices(indices);
+    submesh->build();
+
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+    mesh->addSubMesh(submesh);
+    return mesh;
+}
+
+std::shared_ptr<Texture> createTexture(const std::string& name)
+{
+    Image::Ptr image = Image::create(IMAGE_DIR + name);
+    if (image == nullptr)
+    {
+        std::cerr << "[Error] failed to load image: " << name << std::endl;
+        return nullptr;
+    }
+
+    auto texture = std::make_shared<Texture>();
+    texture->initFromImage(image);
+    return texture;
+}
+
+int main(int argc, char** argv)
+{
+    bool depthPrepass = false;
+    FrameBufferLayout frameBufferLayout = FrameBufferLayout::LINEAR;
+    uint32_t sampleCount = 1;
+    int instances = 0;
+    std::string framePrefix;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--depth-prepass")
+            depthPrepass = true;
+        else if (std::string(argv[i]) == "--tiled-framebuffer")
+            frameBufferLayout = FrameBufferLayout::TILED;
+        else if (std::string(argv[i]) == "--msaa")
+            sampleCount = SOFTGL_MAX_SAMPLES;
+        else if (std::string(argv[i]) == "--instances" && i + 1 < argc)
+            instances = std::stoi(argv[++i]);
+        else if (std::string(argv[i]) == "--save-frames" && i + 1 < argc)
+            framePrefix = argv[++i];
+        else
+            args.emplace_back(argv[i]);
+    }
+
+    const int width  = args.size() > 0 ? std::stoi(args[0]) : 500;
+    const int height = args.size() > 1 ? std::stoi(args[1]) : 500;
+    const int frames = args.size() > 2 ? std::stoi(args[2]) : 1;
+    const std::string output = args.size() > 3 ? args[3] : "SoftRenderer.png";
+    const std::string modelPath = args.size() > 4 ? args[4] : "";
+
+    if (width <= 0 || height <= 0 || frames <= 0 || instances < 0)
+    {
+        std::cerr << "usage: SoftRendererHeadless [--depth-prepass] [--tiled-framebuffer] [--msaa] [--instances N] [--save-frames prefix] [width] [height] [frames] [output.png] [model]" << std::endl;
+        return 1;
+    }
+
+    ShaderManager::instance().init();
+
+    glm::vec3 position(0.0f, 0.0f, 3.0f);
+    glm::vec3 target(0.0f, 1.0f, 0.0f);
+    Camera camera(60.0f, (float)width / (float)height, 0.1f, 100.0f);
+    camera.lookAt(position, target);
+
+    std::shared_ptr<Mesh> model = Mesh::createBox(2, 2, 2, 1, 1, 1);
+    if (!modelPath.empty())
+    {
+        model = std::make_shared<Mesh>();
+        if (!SceneLoader::instance().loadModel(modelPath, model))
+        {
+            return 1;
+        }
+    }
+
+    std::shared_ptr<Mesh> skybox = createSkyboxMesh();
+
+    glm::mat4 modelMat = glm::mat4(1.0f);
+
+    Graphics& render = Graphics::instance();
+    render.init(width, height, frameBufferLayout, sampleCount);
+
+    // static geometry is uploaded once
+    render.createBuffers(model.get());
+    render.createBuffers(skybox.get());
+
+    BlinnPhongMaterial modelMaterial;
+    modelMaterial.setDiffuseColor(glm::vec3(1.0f, 1.0f, 1.0f));
+    modelMaterial.setSpecularColor(glm::vec3(1.0f, 1.0f, 1.0f));
+    modelMaterial.setSpecularShininess(30.0f);
+    modelMaterial.setSpecularStrength(1.0f);
+    modelMaterial.setDiffuseTexture(createTexture("Default_albedo.jpg"));
+
+    SkyboxMaterial skyboxMatrial;
+
+    const std::array<std::pair<std::string, CubeMapFace>, 6> cubemapFaces =
+    {{
+        { "Lake/right.jpg",  CubeMapFace::TEXTURE_CUBE_MAP_POSITIVE_X },
+        { "Lake/left.jpg",   CubeMapFace::TEXTURE_CUBE_MAP_NEGATIVE_X },
+        { "Lake/top.jpg",    CubeMapFace::TEXTURE_CUBE_MAP_POSITIVE_Y },
+        { "Lake/bottom.jpg", CubeMapFace::TEXTURE_CUBE_MAP_NEGATIVE_Y },
+        { "Lake/front.jpg",  CubeMapFace::TEXTURE_CUBE_MAP_POSITIVE_Z },
+        { "Lake/back.jpg",   CubeMapFace::TEXTURE_CUBE_MAP_NEGATIVE_Z },
+    }};
+
+    for (const auto& [name, face] : cubemapFaces)
+    {
+        auto texture = createTexture(name);
+        skyboxMatrial.setCubemapTexture(texture, face);
+    }
+
+    auto light_position = 2.f * glm::vec3(0.0f, 0.0f, 1.0f);
+
+    // --instances draws a row of model copies with one instanced draw
+    std::vector<BlinnPhongShader::ShaderInstanceData> instanceData(instances);
+    for (int i = 0; i < instances; i++)
+    {
+        const glm::mat4 instanceMat = glm::translate(modelMat, glm::vec3(2.5f * (i - 0.5f * (instances - 1)), 0.0f, 0.0f));
+        instanceData[i].modelMatrix = instanceMat;
+        instanceData[i].modelViewProjectMatrix = camera.getProjMatrix() * camera.getViewMatrix() * instanceMat;
+        instanceData[i].inverseTransposeModelMatrix = glm::mat3(glm::transpose(glm::inverse(instanceMat)));
+    }
+
+    CommandBuffer commandBuffer;
+
+    // --save-frames encodes every frame on the present thread while the next one renders
+    int savedFrames = 0;
+    if (!framePrefix.empty())
+    {
+        render.setFramePresenter([&](const FrameBuffer::Ptr& frameBuffer)
+        {
+            frameBuffer->saveColorBuffer(framePrefix + std::to_string(savedFrames++) + ".png");
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int frame = 0; frame < frames; frame++)
+    {
+        render.setViewport(0, 0, width, height);
+        render.clearColorDepth(glm::vec4(0.1, 0.1, 0.1, 1.0), 0.0f);
+
+        // the scene is recorded into a command buffer and submitted once per frame
+        commandBuffer.reset();
+
+        auto drawScene = [&]()
+        {
+            modelMaterial.bind(commandBuffer);
+            modelMaterial.setModelMatrix(modelMat);
+            const glm::mat4 modelMVP = camera.getProjMatrix() * camera.getViewMatrix() * modelMat;
+            modelMaterial.setModelViewProjectMatrix(modelMVP);
+            modelMaterial.setInverseTransposeModelMatrix(glm::mat3(glm::transpose(glm::inverse(modelMat))));
+            modelMaterial.setLightPosition(light_position);
+            modelMaterial.setLightColor(glm::vec3(1.0f, 0.0f, 0.0f));
+            modelMaterial.setCameraPosition(camera.getEye());
+            modelMaterial.updateParameters(commandBuffer);
+            if (instances > 0)
+                commandBuffer.drawMeshInstanced(model.get(), instances, instanceData.data(), sizeof(BlinnPhongShader::ShaderInstanceData));
+            else
+                commandBuffer.drawMesh(model.get(), modelMVP);
+
+            skyboxMatrial.bind(commandBuffer);
+            glm::mat4 skyboxViewMat  = glm::mat3(camera.getViewMatrix());
+            glm::mat4 skyboxMVP = camera.getProjMatrix() * skyboxViewMat * glm::mat4(1.0f);
+            skyboxMatrial.setModelViewProjectMatrix(skyboxMVP);
+            skyboxMatrial.updateParameters(commandBuffer);
+            commandBuffer.drawMesh(skybox.get());
+        };
+
+        if (depthPrepass)
+        {
+            commandBuffer.setDepthPrepass(Graphics::DepthPrepass::PREPASS_DEPTH_ONLY);
+            drawScene();
+            commandBuffer.setDepthPrepass(Graphics::DepthPrepass::PREPASS_SHADING);
+            drawScene();
+            commandBuffer.setDepthPrepass(Graphics::DepthPrepass::PREPASS_DISABLED);
+        }
+        else
+        {
+            drawScene();
+        }
+
+        render.submit(commandBuffer);
+
+        render.swapBuffer();
+    }
+
+    render.waitFramePresenter();
+
+    auto time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "simd: " << SIMD::getLevelName(SIMD::getLevel()) << std::endl;
+    std::cout << "frames: " << frames
+              << " total: " << std::fixed << std::setprecision(2) << time << " ms"
+              << " avg: " << time / frames << " ms" << std::endl;
+
+    if (!render.getOutput()->saveColorBuffer(output))
+    {
+        std::cerr << "[Error] failed to save output image: " << output << std::endl;
+        return 1;
+    }
+
+    render.setFramePresenter(nullptr);
+
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "Texture.h"
+#include "TextureSampling.h"
 
 namespace SoftRenderer
 {
@@ -89,26 +90,6 @@ namespace SoftRenderer
                 originBufferPtr = mMipmaps[mMipmaps.size() - 2].get();
 
                 generatePo2Mipmap(originBufferPtr, currentBufferPtr);
-
-
-                std::vector<uint8_t> out;
-                for (size_t y = 0; y < mipSize; y++)
-                {
-                    for (size_t x = 0; x < mipSize; x++)
-                    {
-                        glm::vec4* pixel = currentBufferPtr->get(x, y);
-
-                        out.push_back((*pixel).r);
-                        out.push_back((*pixel).g);
-                        out.push_back((*pixel).b);
-                        out.push_back((*pixel).a);
-                    }
-                }
-
-                auto outImage = Image::create(mipSize, mipSize, Image::PixelFormat::PF_RGBA8888, out);
-
-                outImage->save("E:\\test.png", Image::PNG);
-
             }
 
             mMipmapGeneratingFlag = false;
@@ -222,6 +203,65 @@ namespace SoftRenderer
         return glm::mix(glm::mix(p0, p1, f.x), glm::mix(p2, p3, f.x), f.y);
     }
 
+    void BaseSampler::sampleBufferNearestQuad(TextureBuffer<glm::vec4>* buffer, const glm::vec2 uv[4], WrapMode wrapMode, const glm::ivec2& offset, glm::vec4 out[4])
+    {
+        if (!buffer->isLinearLayout())
+        {
+            for (int32_t i = 0; i < 4; i++)
+            {
+                out[i] = sampleBufferNearest(buffer, uv[i], wrapMode, offset);
+            }
+            return;
+        }
+
+        const glm::vec4 outside = wrapMode == WrapMode::WRAP_CLAMP_TO_BORDER ? BORDER_COLOR : glm::vec4(0);
+        const TextureSampling::Source source = { buffer->getData(), (int32_t)buffer->getWidth(), (int32_t)buffer->getHeight(), wrapMode, outside };
+        TextureSampling::nearestQuad(source, uv, offset, out);
+    }
+
+    void BaseSampler::sampleBufferBilinearQuad(TextureBuffer<glm::vec4>* buffer, const glm::vec2 uv[4], WrapMode wrapMode, const glm::ivec2& offset, glm::vec4 out[4])
+    {
+        if (!buffer->isLinearLayout())
+        {
+            for (int32_t i = 0; i < 4; i++)
+            {
+                out[i] = sampleBufferBilinear(buffer, uv[i], wrapMode, offset);
+            }
+            return;
+        }
+
+        const glm::vec4 outside = wrapMode == WrapMode::WRAP_CLAMP_TO_BORDER ? BORDER_COLOR : glm::vec4(0);
+        const TextureSampling::Source source = { buffer->getData(), (int32_t)buffer->getWidth(), (int32_t)buffer->getHeight(), wrapMode, outside };
+        TextureSampling::bilinearQuad(source, uv, offset, out);
+    }
+
+    void BaseSampler::sampleTextureQuad(Texture* texture, const glm::vec2 uv[4], glm::vec4 out[4], float lod)
+    {
+        if (texture == nullptr || texture->isEmpty())
+        {
+            std::fill(out, out + 4, glm::vec4(0));
+            return;
+        }
+
+        if (mFilterMode == FilterMode::FILTER_NEAREST)
+        {
+            sampleBufferNearestQuad(texture->mBuffer.get(), uv, mWrapMode, glm::ivec2(0), out);
+            return;
+        }
+
+        if (mFilterMode == FilterMode::FILTER_LINEAR)
+        {
+            sampleBufferBilinearQuad(texture->mBuffer.get(), uv, mWrapMode, glm::ivec2(0), out);
+            return;
+        }
+
+        // mipmapped filters pick their levels per pixel
+        for (int32_t i = 0; i < 4; i++)
+        {
+            out[i] = sampleTexture(texture, uv[i], lod);
+        }
+    }
+
     glm::vec4 BaseSampler::sampleTexture(Texture* texture, const glm::vec2& uv, float lod, const glm::vec2& offset)
     {
         if (texture == nullptr || texture->isEmpty())
@@ -342,6 +382,11 @@ namespace SoftRenderer
         return color;
     }
 
+    void BaseSampler2D::texture2DQuadImpl(const glm::vec2 uv[4], glm::vec4 out[4], float bias)
+    {
+        sampleTextureQuad(mTexture, uv, out, bias);
+    }
+
     glm::vec4 Sampler2D::texture2D(glm::vec2 uv, float bias)
     {
         return texture2DImpl(uv, bias) / 255.0f;
@@ -357,6 +402,15 @@ namespace SoftRenderer
         return texture2DLodImpl(uv, lod, offset) / 255.f;
     }
 
+    void Sampler2D::texture2DQuad(const glm::vec2 uv[4], glm::vec4 out[4], float bias)
+    {
+        texture2DQuadImpl(uv, out, bias);
+        for (int32_t i = 0; i < 4; i++)
+        {
+            out[i] /= 255.0f;
+        }
+    }
+
     BaseSamplerCube::BaseSamplerCube()
     {
         mWrapMode = WrapMode::WRAP_CLAMP_TO_EDGE;
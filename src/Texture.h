@@ -231,6 +231,13 @@ namespace SoftRenderer
 
         static glm::vec4 sampleBufferBilinear(TextureBuffer<glm::vec4>* buffer, const glm::vec2& uv, WrapMode wrapMode, const glm::ivec2& offset);
 
+        // the four texture coordinates of a FragmentQuad at once, filter and wrap mode are resolved once per quad
+        void sampleTextureQuad(Texture* texture, const glm::vec2 uv[4], glm::vec4 out[4], float lod = 0.0f);
+
+        static void sampleBufferNearestQuad(TextureBuffer<glm::vec4>* buffer, const glm::vec2 uv[4], WrapMode wrapMode, const glm::ivec2& offset, glm::vec4 out[4]);
+
+        static void sampleBufferBilinearQuad(TextureBuffer<glm::vec4>* buffer, const glm::vec2 uv[4], WrapMode wrapMode, const glm::ivec2& offset, glm::vec4 out[4]);
+
     public:
         static const glm::vec4 BORDER_COLOR;
 
@@ -251,6 +258,7 @@ namespace SoftRenderer
         bool isEmpty() const override;
         virtual glm::vec4 texture2DImpl(glm::vec2& uv, float bias = 0.0f);
         virtual glm::vec4 texture2DLodImpl(glm::vec2& uv, float lod = 0.0f, glm::ivec2 offset = glm::ivec2(0));
+        virtual void texture2DQuadImpl(const glm::vec2 uv[4], glm::vec4 out[4], float bias = 0.0f);
 
     private:
         Texture* mTexture = nullptr;
@@ -262,6 +270,9 @@ namespace SoftRenderer
         glm::vec4 texture2D(glm::vec2 uv, float bias = 0.0f); 
         glm::vec4 texture2DLod(glm::vec2 uv, float lod = 0.f);
         glm::vec4 texture2DLodOffset(glm::vec2 uv, float lod, glm::ivec2 offset);
+
+        // texture2D of the four pixels of a FragmentQuad
+        void texture2DQuad(const glm::vec2 uv[4], glm::vec4 out[4], float bias = 0.0f);
     };
 
     enum class CubeMapFace : uint8_t
@@ -0,0 +1,351 @@
+#include "TextureSampling.h"
+
+#include <type_traits>
+
+namespace SoftRenderer
+{
+    // size and modulo masks of one texture axis, the masks reproduce the modulo of BaseSampler::sampleBufferWithWrapMode
+    struct WrapAxis
+    {
+        int32_t size;
+        int32_t repeatMask;
+        int32_t mirrorMask;
+    };
+
+    static WrapAxis makeWrapAxis(int32_t size)
+    {
+        return { size, (2 * size - 1) & (size - 1), (4 * size - 1) & (2 * size - 1) };
+    }
+
+    static constexpr bool isBorderWrapMode(WrapMode wrapMode)
+    {
+        return wrapMode == WrapMode::WRAP_CLAMP_TO_BORDER || wrapMode == WrapMode::WRAP_CLAMP_TO_ZERO;
+    }
+
+    // calls kernel with the wrap mode as a compile time constant, so the kernels resolve it once per quad
+    template<typename Kernel>
+    static void dispatchWrapMode(WrapMode wrapMode, Kernel&& kernel)
+    {
+        switch (wrapMode)
+        {
+        case WrapMode::WRAP_REPEAT: kernel(std::integral_constant<WrapMode, WrapMode::WRAP_REPEAT>()); break;
+        case WrapMode::WRAP_MIRRORED_REPEAT: kernel(std::integral_constant<WrapMode, WrapMode::WRAP_MIRRORED_REPEAT>()); break;
+        case WrapMode::WRAP_CLAMP_TO_EDGE: kernel(std::integral_constant<WrapMode, WrapMode::WRAP_CLAMP_TO_EDGE>()); break;
+        case WrapMode::WRAP_CLAMP_TO_BORDER: kernel(std::integral_constant<WrapMode, WrapMode::WRAP_CLAMP_TO_BORDER>()); break;
+        case WrapMode::WRAP_CLAMP_TO_ZERO: kernel(std::integral_constant<WrapMode, WrapMode::WRAP_CLAMP_TO_ZERO>()); break;
+        }
+    }
+
+    // texel coordinate inside the texture, -1 for the border modes when i is outside
+    template<WrapMode W>
+    static inline int32_t wrapTexel(int32_t i, const WrapAxis& axis)
+    {
+        if constexpr (W == WrapMode::WRAP_REPEAT)
+        {
+            return i & axis.repeatMask;
+        }
+        else if constexpr (W == WrapMode::WRAP_MIRRORED_REPEAT)
+        {
+            const int32_t s = (i & axis.mirrorMask) - axis.size;
+            return axis.size - 1 - (s >= 0 ? s : (-1 - s));
+        }
+        else if constexpr (W == WrapMode::WRAP_CLAMP_TO_EDGE)
+        {
+            return std::min(std::max(i, 0), axis.size - 1);
+        }
+        else
+        {
+            return (i >= 0 && i < axis.size) ? i : -1;
+        }
+    }
+
+    template<WrapMode W>
+    static inline const glm::vec4& fetchTexel(const TextureSampling::Source& source, int32_t x, int32_t y)
+    {
+        if constexpr (isBorderWrapMode(W))
+        {
+            if (x < 0 || y < 0)
+            {
+                return source.outside;
+            }
+        }
+        return source.texels[y * source.width + x];
+    }
+
+    template<WrapMode W>
+    static void nearestQuadImpl(const TextureSampling::Source& source, const glm::vec2 uv[TextureSampling::PIXEL_COUNT], const glm::ivec2& offset, glm::vec4 out[TextureSampling::PIXEL_COUNT])
+    {
+        const WrapAxis axisX = makeWrapAxis(source.width);
+        const WrapAxis axisY = makeWrapAxis(source.height);
+
+        for (int32_t p = 0; p < TextureSampling::PIXEL_COUNT; p++)
+        {
+            const int32_t x = (int32_t)(uv[p].x * (float)(source.width - 1) - 0.5f) + offset.x;
+            const int32_t y = (int32_t)(uv[p].y * (float)(source.height - 1) - 0.5f) + offset.y;
+
+            out[p] = fetchTexel<W>(source, wrapTexel<W>(x, axisX), wrapTexel<W>(y, axisY));
+        }
+    }
+
+    template<WrapMode W>
+    static void bilinearQuadScalarImpl(const TextureSampling::Source& source, const glm::vec2 uv[TextureSampling::PIXEL_COUNT], const glm::ivec2& offset, glm::vec4 out[TextureSampling::PIXEL_COUNT])
+    {
+        const WrapAxis axisX = makeWrapAxis(source.width);
+        const WrapAxis axisY = makeWrapAxis(source.height);
+
+        for (int32_t p = 0; p < TextureSampling::PIXEL_COUNT; p++)
+        {
+            const float x = (uv[p].x * (float)source.width - 0.5f) + offset.x;
+            const float y = (uv[p].y * (float)source.height - 0.5f) + offset.y;
+            const int32_t ix = (int32_t)x;
+            const int32_t iy = (int32_t)y;
+
+            const glm::vec2 f = glm::fract(glm::vec2(x, y));
+
+            const int32_t x0 = wrapTexel<W>(ix, axisX);
+            const int32_t x1 = wrapTexel<W>(ix + 1, axisX);
+            const int32_t y0 = wrapTexel<W>(iy, axisY);
+            const int32_t y1 = wrapTexel<W>(iy + 1, axisY);
+
+            const glm::vec4& p0 = fetchTexel<W>(source, x0, y0);
+            const glm::vec4& p1 = fetchTexel<W>(source, x1, y0);
+            const glm::vec4& p2 = fetchTexel<W>(source, x0, y1);
+            const glm::vec4& p3 = fetchTexel<W>(source, x1, y1);
+
+            out[p] = glm::mix(glm::mix(p0, p1, f.x), glm::mix(p2, p3, f.x), f.y);
+        }
+    }
+
+    const TextureSampling::BilinearQuadFunc TextureSampling::sBilinearQuadFunc = TextureSampling::selectBilinearQuadFunc();
+
+    TextureSampling::BilinearQuadFunc TextureSampling::selectBilinearQuadFunc()
+    {
+#if SOFTGL_SIMD_X86
+        switch (SIMD::getLevel())
+        {
+        case SIMDLevel::SIMD_AVX2: return &TextureSampling::bilinearQuadAVX2;
+        case SIMDLevel::SIMD_SSE41: return &TextureSampling::bilinearQuadSSE41;
+        default: break;
+        }
+#endif
+        return &TextureSampling::bilinearQuadScalar;
+    }
+
+    void TextureSampling::nearestQuad(const Source& source, const glm::vec2 uv[PIXEL_COUNT], const glm::ivec2& offset, glm::vec4 out[PIXEL_COUNT])
+    {
+        dispatchWrapMode(source.wrapMode, [&](auto mode) { nearestQuadImpl<decltype(mode)::value>(source, uv, offset, out); });
+    }
+
+    void TextureSampling::bilinearQuadScalar(const Source& source, const glm::vec2 uv[PIXEL_COUNT], const glm::ivec2& offset, glm::vec4 out[PIXEL_COUNT])
+    {
+        dispatchWrapMode(source.wrapMode, [&](auto mode) { bilinearQuadScalarImpl<decltype(mode)::value>(source, uv, offset, out); });
+    }
+
+#if SOFTGL_SIMD_X86
+    // a * (1 - t) + b * t, the same operations as glm::mix so every kernel returns identical texels
+    static inline __m128 lerpSSE(__m128 a, __m128 b, __m128 t)
+    {
+        return _mm_add_ps(_mm_mul_ps(a, _mm_sub_ps(_mm_set1_ps(1.0f), t)), _mm_mul_ps(b, t));
+    }
+
+    template<WrapMode W>
+    static inline __m128 fetchTexelSSE(const TextureSampling::Source& source, int32_t index, __m128 outside)
+    {
+        if constexpr (isBorderWrapMode(W))
+        {
+            if (index < 0)
+            {
+                return outside;
+            }
+        }
+        return _mm_loadu_ps(&source.texels[index].x);
+    }
+
+    template<WrapMode W>
+    SOFTGL_TARGET_SSE41
+    static inline __m128i wrapTexelSSE41(__m128i i, const WrapAxis& axis)
+    {
+        if constexpr (W == WrapMode::WRAP_REPEAT)
+        {
+            return _mm_and_si128(i, _mm_set1_epi32(axis.repeatMask));
+        }
+        else if constexpr (W == WrapMode::WRAP_MIRRORED_REPEAT)
+        {
+            // s ^ (s >> 31) is -1 - s for negative s
+            __m128i s = _mm_sub_epi32(_mm_and_si128(i, _mm_set1_epi32(axis.mirrorMask)), _mm_set1_epi32(axis.size));
+            s = _mm_xor_si128(s, _mm_srai_epi32(s, 31));
+            return _mm_sub_epi32(_mm_set1_epi32(axis.size - 1), s);
+        }
+        else if constexpr (W == WrapMode::WRAP_CLAMP_TO_EDGE)
+        {
+            return _mm_min_epi32(_mm_max_epi32(i, _mm_setzero_si128()), _mm_set1_epi32(axis.size - 1));
+        }
+        else
+        {
+            const __m128i inside = _mm_andnot_si128(_mm_cmplt_epi32(i, _mm_setzero_si128()), _mm_cmplt_epi32(i, _mm_set1_epi32(axis.size)));
+            return _mm_or_si128(i, _mm_cmpeq_epi32(inside, _mm_setzero_si128()));
+        }
+    }
+
+    // -1 for the border modes when x or y is outside
+    template<WrapMode W>
+    SOFTGL_TARGET_SSE41
+    static inline __m128i texelIndexSSE41(__m128i x, __m128i y, __m128i width)
+    {
+        const __m128i index = _mm_add_epi32(_mm_mullo_epi32(y, width), x);
+        if constexpr (isBorderWrapMode(W))
+        {
+            return _mm_or_si128(index, _mm_srai_epi32(_mm_or_si128(x, y), 31));
+        }
+        return index;
+    }
+
+    template<WrapMode W>
+    SOFTGL_TARGET_SSE41
+    static void bilinearQuadSSE41Impl(const TextureSampling::Source& source, const glm::vec2 uv[TextureSampling::PIXEL_COUNT], const glm::ivec2& offset, glm::vec4 out[TextureSampling::PIXEL_COUNT])
+    {
+        const WrapAxis axisX = makeWrapAxis(source.width);
+        const WrapAxis axisY = makeWrapAxis(source.height);
+
+        const __m128 u = _mm_setr_ps(uv[0].x, uv[1].x, uv[2].x, uv[3].x);
+        const __m128 v = _mm_setr_ps(uv[0].y, uv[1].y, uv[2].y, uv[3].y);
+        const __m128 x = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(u, _mm_set1_ps((float)source.width)), _mm_set1_ps(0.5f)), _mm_set1_ps((float)offset.x));
+        const __m128 y = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(v, _mm_set1_ps((float)source.height)), _mm_set1_ps(0.5f)), _mm_set1_ps((float)offset.y));
+        const __m128i ix = _mm_cvttps_epi32(x);
+        const __m128i iy = _mm_cvttps_epi32(y);
+
+        const __m128i x0 = wrapTexelSSE41<W>(ix, axisX);
+        const __m128i x1 = wrapTexelSSE41<W>(_mm_add_epi32(ix, _mm_set1_epi32(1)), axisX);
+        const __m128i y0 = wrapTexelSSE41<W>(iy, axisY);
+        const __m128i y1 = wrapTexelSSE41<W>(_mm_add_epi32(iy, _mm_set1_epi32(1)), axisY);
+        const __m128i width = _mm_set1_epi32(source.width);
+
+        // texel p0..p3 of sampleBufferBilinear for each pixel
+        alignas(16) int32_t index[4][TextureSampling::PIXEL_COUNT];
+        _mm_store_si128((__m128i*)index[0], texelIndexSSE41<W>(x0, y0, width));
+        _mm_store_si128((__m128i*)index[1], texelIndexSSE41<W>(x1, y0, width));
+        _mm_store_si128((__m128i*)index[2], texelIndexSSE41<W>(x0, y1, width));
+        _mm_store_si128((__m128i*)index[3], texelIndexSSE41<W>(x1, y1, width));
+
+        alignas(16) float fx[TextureSampling::PIXEL_COUNT];
+        alignas(16) float fy[TextureSampling::PIXEL_COUNT];
+        _mm_store_ps(fx, _mm_sub_ps(x, _mm_floor_ps(x)));
+        _mm_store_ps(fy, _mm_sub_ps(y, _mm_floor_ps(y)));
+
+        const __m128 outside = _mm_loadu_ps(&source.outside.x);
+        for (int32_t p = 0; p < TextureSampling::PIXEL_COUNT; p++)
+        {
+            const __m128 p0 = fetchTexelSSE<W>(source, index[0][p], outside);
+            const __m128 p1 = fetchTexelSSE<W>(source, index[1][p], outside);
+            const __m128 p2 = fetchTexelSSE<W>(source, index[2][p], outside);
+            const __m128 p3 = fetchTexelSSE<W>(source, index[3][p], outside);
+
+            const __m128 tx = _mm_set1_ps(fx[p]);
+            _mm_storeu_ps(&out[p].x, lerpSSE(lerpSSE(p0, p1, tx), lerpSSE(p2, p3, tx), _mm_set1_ps(fy[p])));
+        }
+    }
+
+    template<WrapMode W>
+    SOFTGL_TARGET_AVX2
+    static inline __m256i wrapTexelAVX2(__m256i i, const WrapAxis& axis)
+    {
+        if constexpr (W == WrapMode::WRAP_REPEAT)
+        {
+            return _mm256_and_si256(i, _mm256_set1_epi32(axis.repeatMask));
+        }
+        else if constexpr (W == WrapMode::WRAP_MIRRORED_REPEAT)
+        {
+            __m256i s = _mm256_sub_epi32(_mm256_and_si256(i, _mm256_set1_epi32(axis.mirrorMask)), _mm256_set1_epi32(axis.size));
+            s = _mm256_xor_si256(s, _mm256_srai_epi32(s, 31));
+            return _mm256_sub_epi32(_mm256_set1_epi32(axis.size - 1), s);
+        }
+        else if constexpr (W == WrapMode::WRAP_CLAMP_TO_EDGE)
+        {
+            return _mm256_min_epi32(_mm256_max_epi32(i, _mm256_setzero_si256()), _mm256_set1_epi32(axis.size - 1));
+        }
+        else
+        {
+            const __m256i inside = _mm256_andnot_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), i), _mm256_cmpgt_epi32(_mm256_set1_epi32(axis.size), i));
+            return _mm256_or_si256(i, _mm256_cmpeq_epi32(inside, _mm256_setzero_si256()));
+        }
+    }
+
+    template<WrapMode W>
+    SOFTGL_TARGET_AVX2
+    static inline __m256i texelIndexAVX2(__m256i x, __m256i y, __m256i width)
+    {
+        const __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(y, width), x);
+        if constexpr (isBorderWrapMode(W))
+        {
+            return _mm256_or_si256(index, _mm256_srai_epi32(_mm256_or_si256(x, y), 31));
+        }
+        return index;
+    }
+
+    SOFTGL_TARGET_AVX2
+    static inline __m256 combineAVX2(__m128 low, __m128 high)
+    {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1);
+    }
+
+    // fused, so texels may differ from the other kernels in the last bit
+    SOFTGL_TARGET_AVX2
+    static inline __m256 lerpAVX2(__m256 a, __m256 b, __m256 t)
+    {
+        return _mm256_fmadd_ps(b, t, _mm256_mul_ps(a, _mm256_sub_ps(_mm256_set1_ps(1.0f), t)));
+    }
+
+    template<WrapMode W>
+    SOFTGL_TARGET_AVX2
+    static void bilinearQuadAVX2Impl(const TextureSampling::Source& source, const glm::vec2 uv[TextureSampling::PIXEL_COUNT], const glm::ivec2& offset, glm::vec4 out[TextureSampling::PIXEL_COUNT])
+    {
+        const WrapAxis axisX = makeWrapAxis(source.width);
+        const WrapAxis axisY = makeWrapAxis(source.height);
+
+        const __m128 u = _mm_setr_ps(uv[0].x, uv[1].x, uv[2].x, uv[3].x);
+        const __m128 v = _mm_setr_ps(uv[0].y, uv[1].y, uv[2].y, uv[3].y);
+        const __m128 x = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(u, _mm_set1_ps((float)source.width)), _mm_set1_ps(0.5f)), _mm_set1_ps((float)offset.x));
+        const __m128 y = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(v, _mm_set1_ps((float)source.height)), _mm_set1_ps(0.5f)), _mm_set1_ps((float)offset.y));
+
+        // lanes 0-3 hold ix of the four pixels and lanes 4-7 ix + 1, the same for y
+        const __m256i step = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+        const __m256i xx = wrapTexelAVX2<W>(_mm256_add_epi32(_mm256_broadcastsi128_si256(_mm_cvttps_epi32(x)), step), axisX);
+        const __m256i yy = wrapTexelAVX2<W>(_mm256_add_epi32(_mm256_broadcastsi128_si256(_mm_cvttps_epi32(y)), step), axisY);
+        const __m256i width = _mm256_set1_epi32(source.width);
+
+        // row 0 holds texels p0 and p1 of sampleBufferBilinear, row 1 texels p2 and p3
+        alignas(32) int32_t index[2][8];
+        _mm256_store_si256((__m256i*)index[0], texelIndexAVX2<W>(xx, _mm256_permute2x128_si256(yy, yy, 0x00), width));
+        _mm256_store_si256((__m256i*)index[1], texelIndexAVX2<W>(xx, _mm256_permute2x128_si256(yy, yy, 0x11), width));
+
+        alignas(16) float fx[TextureSampling::PIXEL_COUNT];
+        alignas(16) float fy[TextureSampling::PIXEL_COUNT];
+        _mm_store_ps(fx, _mm_sub_ps(x, _mm_floor_ps(x)));
+        _mm_store_ps(fy, _mm_sub_ps(y, _mm_floor_ps(y)));
+
+        // two pixels per register
+        const __m128 outside = _mm_loadu_ps(&source.outside.x);
+        for (int32_t p = 0; p < TextureSampling::PIXEL_COUNT; p += 2)
+        {
+            const __m256 p0 = combineAVX2(fetchTexelSSE<W>(source, index[0][p], outside), fetchTexelSSE<W>(source, index[0][p + 1], outside));
+            const __m256 p1 = combineAVX2(fetchTexelSSE<W>(source, index[0][p + 4], outside), fetchTexelSSE<W>(source, index[0][p + 5], outside));
+            const __m256 p2 = combineAVX2(fetchTexelSSE<W>(source, index[1][p], outside), fetchTexelSSE<W>(source, index[1][p + 1], outside));
+            const __m256 p3 = combineAVX2(fetchTexelSSE<W>(source, index[1][p + 4], outside), fetchTexelSSE<W>(source, index[1][p + 5], outside));
+
+            const __m256 tx = combineAVX2(_mm_set1_ps(fx[p]), _mm_set1_ps(fx[p + 1]));
+            const __m256 ty = combineAVX2(_mm_set1_ps(fy[p]), _mm_set1_ps(fy[p + 1]));
+            _mm256_storeu_ps(&out[p].x, lerpAVX2(lerpAVX2(p0, p1, tx), lerpAVX2(p2, p3, tx), ty));
+        }
+    }
+
+    void TextureSampling::bilinearQuadSSE41(const Source& source, const glm::vec2 uv[PIXEL_COUNT], const glm::ivec2& offset, glm::vec4 out[PIXEL_COUNT])
+    {
+        dispatchWrapMode(source.wrapMode, [&](auto mode) { bilinearQuadSSE41Impl<decltype(mode)::value>(source, uv, offset, out); });
+    }
+
+    void TextureSampling::bilinearQuadAVX2(const Source& source, const glm::vec2 uv[PIXEL_COUNT], const glm::ivec2& offset, glm::vec4 out[PIXEL_COUNT])
+    {
+        dispatchWrapMode(source.wrapMode, [&](auto mode) { bilinearQuadAVX2Impl<decltype(mode)::value>(source, uv, offset, out); });
+    }
+#endif
+}
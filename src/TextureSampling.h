@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+#include "SIMD.h"
+#include "Texture.h"
+
+namespace SoftRenderer
+{
+    /**
+     * Samples the four texture coordinates of a FragmentQuad at once from a row major texture.
+     * The wrap mode is resolved once per quad, the kernels generate the 16 texel addresses of bilinear filtering
+     * together and blend a whole RGBA texel per instruction. Results match BaseSampler::sampleBufferBilinear and
+     * BaseSampler::sampleBufferNearest, up to the rounding of the fused blend of the AVX2 kernel. Texels are not normalized.
+     */
+    class TextureSampling
+    {
+    public:
+        static constexpr int32_t PIXEL_COUNT = 4;
+
+        // texels: width * height row major texels, outside: value of texels outside CLAMP_TO_BORDER and CLAMP_TO_ZERO
+        struct Source
+        {
+            const glm::vec4* texels;
+            int32_t width;
+            int32_t height;
+            WrapMode wrapMode;
+            glm::vec4 outside;
+        };
+
+        static void bilinearQuad(const Source& source, const glm::vec2 uv[PIXEL_COUNT], const glm::ivec2& offset, glm::vec4 out[PIXEL_COUNT])
+        {
+            sBilinearQuadFunc(source, uv, offset, out);
+        }
+
+        static void nearestQuad(const Source& source, const glm::vec2 uv[PIXEL_COUNT], const glm::ivec2& offset, glm::vec4 out[PIXEL_COUNT]);
+
+        static void bilinearQuadScalar(const Source& source, const glm::vec2 uv[PIXEL_COUNT], const glm::ivec2& offset, glm::vec4 out[PIXEL_COUNT]);
+
+#if SOFTGL_SIMD_X86
+        static void bilinearQuadSSE41(const Source& source, const glm::vec2 uv[PIXEL_COUNT], const glm::ivec2& offset, glm::vec4 out[PIXEL_COUNT]);
+
+        static void bilinearQuadAVX2(const Source& source, const glm::vec2 uv[PIXEL_COUNT], const glm::ivec2& offset, glm::vec4 out[PIXEL_COUNT]);
+#endif
+
+    private:
+        using BilinearQuadFunc = void(*)(const Source&, const glm::vec2[PIXEL_COUNT], const glm::ivec2&, glm::vec4[PIXEL_COUNT]);
+
+        static BilinearQuadFunc selectBilinearQuadFunc();
+
+        static const BilinearQuadFunc sBilinearQuadFunc;
+    };
+}
@@ -0,0 +1,93 @@
+#include "VaryingInterpolation.h"
+
+namespace SoftRenderer
+{
+    const VaryingInterpolation::InterpolateQuadFunc VaryingInterpolation::sInterpolateQuadFunc = VaryingInterpolation::selectInterpolateQuadFunc();
+
+    VaryingInterpolation::InterpolateQuadFunc VaryingInterpolation::selectInterpolateQuadFunc()
+    {
+#if SOFTGL_SIMD_X86
+        switch (SIMD::getLevel())
+        {
+        case SIMDLevel::SIMD_AVX2: return &VaryingInterpolation::interpolateQuadAVX2;
+        case SIMDLevel::SIMD_SSE41: return &VaryingInterpolation::interpolateQuadSSE41;
+        default: break;
+        }
+#endif
+        return &VaryingInterpolation::interpolateQuadScalar;
+    }
+
+    void VaryingInterpolation::interpolateQuadScalar(float* const out[PIXEL_COUNT], const float* const in[3], const float weights[PIXEL_COUNT][3], uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const float v0 = in[0][i];
+            const float v1 = in[1][i];
+            const float v2 = in[2][i];
+
+            for (int32_t p = 0; p < PIXEL_COUNT; p++)
+            {
+                out[p][i] = v0 * weights[p][0] + v1 * weights[p][1] + v2 * weights[p][2];
+            }
+        }
+    }
+
+#if SOFTGL_SIMD_X86
+    SOFTGL_TARGET_SSE41
+    void VaryingInterpolation::interpolateQuadSSE41(float* const out[PIXEL_COUNT], const float* const in[3], const float weights[PIXEL_COUNT][3], uint32_t count)
+    {
+        __m128 w[PIXEL_COUNT][3];
+        for (int32_t p = 0; p < PIXEL_COUNT; p++)
+        {
+            for (int32_t v = 0; v < 3; v++)
+            {
+                w[p][v] = _mm_set1_ps(weights[p][v]);
+            }
+        }
+
+        for (uint32_t i = 0; i < count; i += 4)
+        {
+            const __m128 v0 = _mm_load_ps(in[0] + i);
+            const __m128 v1 = _mm_load_ps(in[1] + i);
+            const __m128 v2 = _mm_load_ps(in[2] + i);
+
+            for (int32_t p = 0; p < PIXEL_COUNT; p++)
+            {
+                __m128 value = _mm_mul_ps(v0, w[p][0]);
+                value = _mm_add_ps(value, _mm_mul_ps(v1, w[p][1]));
+                value = _mm_add_ps(value, _mm_mul_ps(v2, w[p][2]));
+                _mm_store_ps(out[p] + i, value);
+            }
+        }
+    }
+
+    SOFTGL_TARGET_AVX2
+    void VaryingInterpolation::interpolateQuadAVX2(float* const out[PIXEL_COUNT], const float* const in[3], const float weights[PIXEL_COUNT][3], uint32_t count)
+    {
+        // 12 broadcast weights and 3 vertex lanes fit the 16 ymm registers
+        __m256 w[PIXEL_COUNT][3];
+        for (int32_t p = 0; p < PIXEL_COUNT; p++)
+        {
+            for (int32_t v = 0; v < 3; v++)
+            {
+                w[p][v] = _mm256_set1_ps(weights[p][v]);
+            }
+        }
+
+        for (uint32_t i = 0; i < count; i += 8)
+        {
+            const __m256 v0 = _mm256_load_ps(in[0] + i);
+            const __m256 v1 = _mm256_load_ps(in[1] + i);
+            const __m256 v2 = _mm256_load_ps(in[2] + i);
+
+            for (int32_t p = 0; p < PIXEL_COUNT; p++)
+            {
+                __m256 value = _mm256_mul_ps(v0, w[p][0]);
+                value = _mm256_fmadd_ps(v1, w[p][1], value);
+                value = _mm256_fmadd_ps(v2, w[p][2], value);
+                _mm256_store_ps(out[p] + i, value);
+            }
+        }
+    }
+#endif
+}
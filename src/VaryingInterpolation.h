@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+#include "SIMD.h"
+
+namespace SoftRenderer
+{
+    /**
+     * Interpolates the varyings of the four pixels of a FragmentQuad at once, every vertex varying is loaded once per quad.
+     * Varyings live in slots of RenderContex::varyingsAlignedSize bytes, 32 byte aligned, so the kernels work on
+     * whole 8 float lanes and also fill the padding of each slot.
+     */
+    class VaryingInterpolation
+    {
+    public:
+        static constexpr int32_t PIXEL_COUNT = 4;
+
+        // out[p][i] = sum of weights[p][v] * in[v][i], count is the aligned float count of a slot
+        static void interpolateQuad(float* const out[PIXEL_COUNT], const float* const in[3], const float weights[PIXEL_COUNT][3], uint32_t count)
+        {
+            sInterpolateQuadFunc(out, in, weights, count);
+        }
+
+        static void interpolateQuadScalar(float* const out[PIXEL_COUNT], const float* const in[3], const float weights[PIXEL_COUNT][3], uint32_t count);
+
+#if SOFTGL_SIMD_X86
+        static void interpolateQuadSSE41(float* const out[PIXEL_COUNT], const float* const in[3], const float weights[PIXEL_COUNT][3], uint32_t count);
+
+        static void interpolateQuadAVX2(float* const out[PIXEL_COUNT], const float* const in[3], const float weights[PIXEL_COUNT][3], uint32_t count);
+#endif
+
+    private:
+        using InterpolateQuadFunc = void(*)(float* const[PIXEL_COUNT], const float* const[3], const float[PIXEL_COUNT][3], uint32_t);
+
+        static InterpolateQuadFunc selectInterpolateQuadFunc();
+
+        static const InterpolateQuadFunc sInterpolateQuadFunc;
+    };
+}
@@ -321,6 +321,9 @@ namespace SoftRenderer
             int height = src->getHeight();
             int r, c;
 
+            // the tiled layout is detiled by every readback, so read it once
+            const unsigned char* colorBuffer = src->getColorBuffer();
+
             //assert(src->width == dst->width && src->height == dst->height);
             //assert(dst->format == FORMAT_LDR && dst->channels == 4);
 
@@ -330,7 +333,7 @@ namespace SoftRenderer
                     int src_index = (r * width + c) * 4;
                     int dst_index = (flipped_r * width + c) * 4;
 
-                    unsigned char* src_pixel = &(src->getColorBuffer()[src_index]);
+                    const unsigned char* src_pixel = &colorBuffer[src_index];
 
                     //unsigned char* src_pixel = src.getColorBuffer();//&src.[src_index];
                     unsigned char* dst_pixel = &dst[dst_index];